@@ -19,10 +19,10 @@ struct AnimNodeData
 
 
 /** This is the name used to find an AnimNode by name from a tree */
-var(Node) string[MAX_NODE_NAME]	Name;
+var(Node) native string[MAX_NODE_NAME] Name;
 
 /** AnimTree this node belongs to */
-var AnimTree				Owner;
+var transient AnimTree		Owner;
 
 
 /**
@@ -45,13 +45,13 @@ struct AnimNodeChild
  * Parent nodes by AnimTree hierarchy. These nodes uses output from this node
  * as input value.
  */
-var array<AnimNode>			Parents;
+var native array<AnimNode>	Parents;
 /** Nodes, provides input values for this AnimNode */
-var array<AnimNodeChild>	Children;
+var native array<AnimNodeChild> Children;
 
 
 /**
- * Drawing parameters
+ * Drawing parameters (not serialized natively: saved using typeinfo)
  */
 
 /** Rectangle */
@@ -1,5 +1,6 @@
 #include "Core.h"
 #include "AnimClasses.h"
+#include "FileReaderMapped.h"
 
 
 /*-----------------------------------------------------------------------------
@@ -19,90 +20,94 @@
 #endif
 
 
-void CMeshAnimSeq::GetBonePosition(int TrackIndex, float Frame, bool Loop, CVec3 &DstPos, CQuat &DstQuat) const
+// Find key for specified frame: returns index of the last key with time not greater
+// than Frame
+template<class T> static int FindKey(const T *KeyTime, int NumKeys, float Frame)
 {
-	guard(CMeshAnimSeq::GetBonePosition);
-
 	int i;
-
-	const CAnalogTrack &A = Tracks[TrackIndex];
-
-	// fast case: 1 frame only
-	if (A.KeyTime.Num() == 1)
-	{
-		DstPos  = A.KeyPos[0];
-		DstQuat = A.KeyQuat[0];
-		return;
-	}
-
-	// find index in time key array
-	int NumKeys = A.KeyTime.Num();
 	// *** binary search ***
 	int Low = 0, High = NumKeys-1;
 	DBG(">>> find %.5f\n", Frame);
 	while (Low + MAX_LINEAR_KEYS < High)
 	{
 		int Mid = (Low + High) / 2;
-		DBG("   [%d..%d] mid: [%d]=%.5f", Low, High, Mid, A.KeyTime[Mid]);
-		if (Frame < A.KeyTime[Mid])
+		DBG("   [%d..%d] mid: [%d]=%.5f", Low, High, Mid, (float)KeyTime[Mid]);
+		if (Frame < KeyTime[Mid])
 			High = Mid-1;
 		else
 			Low = Mid;
-		DBG("   d=%f\n", A.KeyTime[Mid]-Frame);
+		DBG("   d=%f\n", KeyTime[Mid]-Frame);
 	}
 
 	// *** linear search ***
 	DBG("   linear: %d..%d\n", Low, High);
 	for (i = Low; i <= High; i++)
 	{
-		float CurrKeyTime = A.KeyTime[i];
-		DBG("   #%d: %.5f\n", i, CurrKeyTime);
-		if (Frame == CurrKeyTime)
-		{
-			// exact key found
-			DstPos  = (A.KeyPos.Num()  > 1) ? A.KeyPos[i]  : A.KeyPos[0];
-			DstQuat = (A.KeyQuat.Num() > 1) ? A.KeyQuat[i] : A.KeyQuat[0];
-			return;
-		}
-		if (Frame < CurrKeyTime)
-		{
-			i--;
+		DBG("   #%d: %.5f\n", i, (float)KeyTime[i]);
+		if (Frame < KeyTime[i])
 			break;
-		}
 	}
-	if (i > High)
-		i = High;
+	i--;
 
 #if DEBUG_BIN_SEARCH
 	EXEC_ONCE(appPrintf("!!! WARNING: DEBUG_BIN_SEARCH enabled !!!\n"))
 	//!! --- checker ---
 	int i1;
 	for (i1 = 0; i1 < NumKeys; i1++)
-	{
-		float CurrKeyTime = A.KeyTime[i1];
-		if (Frame == CurrKeyTime)
-		{
-			// exact key found
-			DstPos  = (A.KeyPos.Num()  > 1) ? A.KeyPos[i]  : A.KeyPos[0];
-			DstQuat = (A.KeyQuat.Num() > 1) ? A.KeyQuat[i] : A.KeyQuat[0];
-			return;
-		}
-		if (Frame < CurrKeyTime)
-		{
-			i1--;
+		if (Frame < KeyTime[i1])
 			break;
-		}
-	}
-	if (i1 > NumKeys-1)
-		i1 = NumKeys-1;
+	i1--;
 	if (i != i1)
-	{
 		appError("i=%d != i1=%d", i, i1);
-	}
 #endif
 
-	int X = i;
-	int Y = i+1;
+	return max(i, 0);
+}
+
+
+void CMeshAnimSeq::GetBonePosition(int TrackIndex, float Frame, bool Loop, CVec3 &DstPos, CQuat &DstQuat) const
+{
+	guardSlow(CMeshAnimSeq::GetBonePosition);
+
+	const CAnalogTrack &A = GetTrack(TrackIndex);
+
+	// NOTE: when position track was stripped (KeyPos is empty), DstPos is not
+	// modified; caller should fill it with reference pose position
+
+	// fast case: 1 frame only
+	int NumKeys = A.GetNumKeys();
+	if (NumKeys == 1)
+	{
+		if (A.KeyPos.Num()) DstPos = A.KeyPos[0];
+		DstQuat = A.KeyQuat[0];
+		return;
+	}
+
+	// find key index
+	int X;
+	if (A.KeyTime.Num())
+		X = FindKey(&A.KeyTime[0], NumKeys, Frame);
+	else if (A.KeyFrame8.Num())
+		X = FindKey(&A.KeyFrame8[0], NumKeys, Frame);
+	else if (A.KeyFrame16.Num())
+		X = FindKey(&A.KeyFrame16[0], NumKeys, Frame);
+	else
+	{
+		// uniformly sampled track: compute key index directly
+		X = appFloor(Frame / A.KeyStep);
+		X = bound(X, 0, NumKeys-1);
+	}
+
+	float TimeX = A.GetKeyTime(X);
+	if (Frame == TimeX)
+	{
+		// exact key found
+		if (A.KeyPos.Num()) DstPos = (A.KeyPos.Num() > 1) ? A.KeyPos[X] : A.KeyPos[0];
+		DstQuat = (A.KeyQuat.Num() > 1) ? A.KeyQuat[X] : A.KeyQuat[0];
+		return;
+	}
+
+	int Y = X+1;
 	float frac;
 	if (Y >= NumKeys)
 	{
@@ -117,12 +122,12 @@ void CMeshAnimSeq::GetBonePosition(int TrackIndex, float Frame, bool Loop, CVec3
 		{
 			// loop animation
 			Y = 0;
-			frac = (Frame - A.KeyTime[X]) / (NumFrames - A.KeyTime[X]);
+			frac = (Frame - TimeX) / (NumFrames - TimeX);
 		}
 	}
 	else
 	{
-		frac = (Frame - A.KeyTime[X]) / (A.KeyTime[Y] - A.KeyTime[X]);
+		frac = (Frame - TimeX) / (A.GetKeyTime(Y) - TimeX);
 	}
 
 	assert(X >= 0 && X < NumKeys);
@@ -131,7 +136,7 @@ void CMeshAnimSeq::GetBonePosition(int TrackIndex, float Frame, bool Loop, CVec3
 	// get position
 	if (A.KeyPos.Num() > 1)
 		Lerp(A.KeyPos[X], A.KeyPos[Y], frac, DstPos);
-	else
+	else if (A.KeyPos.Num())
 		DstPos = A.KeyPos[0];
 	// get orientation
 	if (A.KeyQuat.Num() > 1)
@@ -139,7 +144,7 @@ void CMeshAnimSeq::GetBonePosition(int TrackIndex, float Frame, bool Loop, CVec3
 	else
 		DstQuat = A.KeyQuat[0];
 
-	unguard;
+	unguardSlow;
 }
 
 
@@ -147,15 +152,12 @@ void CMeshAnimSeq::GetMemFootprint(int *Compressed, int *Uncompressed)
 {
 	int uncompr = sizeof(CMeshAnimSeq) + sizeof(CAnalogTrack);
 	int compr   = uncompr;
-	uncompr += (sizeof(CQuat) + sizeof(CVec3) + sizeof(CVec3) + sizeof(float)) * NumFrames * Tracks.Num();
+	int NumTracks = max(Tracks.Num(), TrackRefs.Num());
+	uncompr += (sizeof(CQuat) + sizeof(CVec3) + sizeof(CVec3) + sizeof(float)) * NumFrames * NumTracks;
+	// shared tracks are accounted by CAnimSet
+	compr += sizeof(int) * TrackRefs.Num();
 	for (int track = 0; track < Tracks.Num(); track++)
-	{
-		const CAnalogTrack &T = Tracks[track];
-		compr += sizeof(CQuat) * T.KeyQuat.Num()
-			  +  sizeof(CVec3) * T.KeyPos.Num()
-			  +  sizeof(CVec3) * T.KeyScale.Num()
-			  +  sizeof(float) * T.KeyTime.Num();
-	}
+		compr += Tracks[track].GetKeysSize();
 	if (Compressed)   *Compressed   = compr;
 	if (Uncompressed) *Uncompressed = uncompr;
 }
@@ -176,6 +178,8 @@ void CAnimSet::GetMemFootprint(int *Compressed, int *Uncompressed)
 		compr   += c;
 		uncompr += u;
 	}
+	for (int track = 0; track < TrackPool.Num(); track++)
+		compr += sizeof(CAnalogTrack) + TrackPool[track].GetKeysSize();
 	if (Compressed)   *Compressed   = compr;
 	if (Uncompressed) *Uncompressed = uncompr;
 }
@@ -192,3 +196,261 @@ const CMeshAnimSeq *CAnimSet::FindAnim(const char *AnimName) const
 	}
 	return NULL;
 }
+
+
+void CAnimSet::LinkTrackPool()
+{
+	for (int seq = 0; seq < Sequences.Num(); seq++)
+		Sequences[seq].PoolData = TrackPool.Num() ? &TrackPool[0] : NULL;
+}
+
+
+/*-----------------------------------------------------------------------------
+	CAnimSet serialization and lazy loading
+-----------------------------------------------------------------------------*/
+
+/*
+ *	AnimSet layout (ArVer >= 2):
+ *		TrackBoneName
+ *		AnimRotationOnly
+ *		TrackPool							(ArVer >= 3)
+ *		int		DirOffset			position of sequence directory
+ *		...							tracks of all sequences
+ *		index	NumSequences		sequence directory
+ *		{
+ *			Name, Rate, NumFrames, Notifies
+ *			TrackRefs						(ArVer >= 3)
+ *			int	TrackDataOffset		position of sequence tracks
+ *			int	TrackDataSize
+ *		}
+ *	Directory is placed after track data, so it could be saved in a single pass with
+ *	one backward seek. Files of ArVer 1 have tracks stored inline with sequence headers,
+ *	such AnimSet is always loaded completely.
+ */
+
+static void SerializeSeqHeader(CArchive &Ar, CMeshAnimSeq &S)
+{
+	Ar << S.Name << S.Rate << S.NumFrames << S.Notifies;
+	if (Ar.ArVer >= 3) Ar << S.TrackRefs;
+	Ar << S.TrackDataOffset << S.TrackDataSize;
+}
+
+
+void CAnimSet::Serialize(CArchive &Ar)
+{
+	guard(CAnimSet::Serialize);
+
+	Super::Serialize(Ar);
+	Ar << TrackBoneName;
+	if (Ar.ArVer < 2)
+	{
+		Ar << Sequences << AnimRotationOnly;
+		return;
+	}
+	Ar << AnimRotationOnly;
+	if (Ar.ArVer >= 3) Ar << TrackPool;
+
+	int seq;
+	int DirOffset = 0;
+	if (!Ar.IsLoading)
+	{
+		for (seq = 0; seq < Sequences.Num(); seq++)
+			if (Sequences[seq].TracksPending)
+				appError("Saving AnimSet with not loaded sequence %s", *Sequences[seq].Name);
+		// write placeholder for directory offset
+		int DirPos = Ar.Tell();
+		Ar << DirOffset;
+		// write tracks
+		for (seq = 0; seq < Sequences.Num(); seq++)
+		{
+			CMeshAnimSeq &S = Sequences[seq];
+			S.TrackDataOffset = Ar.Tell();
+			Ar << S.Tracks;
+			S.TrackDataSize = Ar.Tell() - S.TrackDataOffset;
+		}
+		// write directory
+		DirOffset = Ar.Tell();
+		int NumSeqs = Sequences.Num();
+		Ar << AR_INDEX(NumSeqs);
+		for (seq = 0; seq < NumSeqs; seq++)
+			SerializeSeqHeader(Ar, Sequences[seq]);
+		// patch directory offset
+		int EndPos = Ar.Tell();
+		Ar.Seek(DirPos);
+		Ar << DirOffset;
+		Ar.Seek(EndPos);
+	}
+	else
+	{
+		// read directory
+		Ar << DirOffset;
+		Ar.Seek(DirOffset);
+		int NumSeqs;
+		Ar << AR_INDEX(NumSeqs);
+		Sequences.Empty(NumSeqs);
+		Sequences.Add(NumSeqs);
+		for (seq = 0; seq < NumSeqs; seq++)
+			SerializeSeqHeader(Ar, Sequences[seq]);
+		int EndPos = Ar.Tell();
+		// read tracks; compressed AnimSet could not be loaded lazily, because track
+		// positions are not file positions
+		if (Ar.IsUnpacked) LazyLoad = false;
+		SourceVersion = Ar.ArVer;
+		for (seq = 0; seq < NumSeqs; seq++)
+		{
+			CMeshAnimSeq &S = Sequences[seq];
+			if (LazyLoad)
+			{
+				S.TracksPending = true;
+				continue;
+			}
+			Ar.Seek(S.TrackDataOffset);
+			Ar << S.Tracks;
+		}
+		Ar.Seek(EndPos);
+		LinkTrackPool();
+	}
+
+	unguard;
+}
+
+
+CAnimSet::~CAnimSet()
+{
+	delete SourceAr;
+}
+
+
+CAnimSet* CAnimSet::LoadObjectLazy(const char *From, int MemoryBudget)
+{
+	guard(CAnimSet::LoadObjectLazy);
+
+	CMappedFile *Ar = new CMappedFile;
+	if (!Ar->Open(From))
+	{
+		delete Ar;
+		return NULL;
+	}
+
+	CAnimSet *Obj = new CAnimSet;
+	Obj->LazyLoad     = true;
+	Obj->MemoryBudget = MemoryBudget;
+	Obj->SourceFile   = From;
+	// file is kept mapped for loading of sequences
+	Obj->SourceAr     = Ar;
+	try
+	{
+		SerializeObject(Obj, *Ar);
+	}
+	catch (...)
+	{
+		delete Obj;
+		throw;
+	}
+	if (!Obj->LazyLoad)
+	{
+		// compressed file was loaded completely
+		delete Ar;
+		Obj->SourceAr = NULL;
+	}
+	return Obj;
+
+	unguardf(("%s", From));
+}
+
+
+void CAnimSet::LoadAllSequences()
+{
+	guard(CAnimSet::LoadAllSequences);
+	// memory budget is not applied here: all sequences should remain loaded
+	int Budget = MemoryBudget;
+	MemoryBudget = 0;
+	for (int seq = 0; seq < Sequences.Num(); seq++)
+		if (Sequences[seq].TracksPending)
+			LoadSequence(Sequences[seq]);
+	MemoryBudget = Budget;
+	unguard;
+}
+
+
+CMeshAnimSeq &CAnimSet::GetSequence(const CMeshAnimSeq *Seq)
+{
+	int Index = Seq - &Sequences[0];
+	assert(Index >= 0 && Index < Sequences.Num());
+	return Sequences[Index];
+}
+
+
+void CAnimSet::PinSequence(const CMeshAnimSeq *Seq)
+{
+	if (!LazyLoad) return;
+	CMeshAnimSeq &S = GetSequence(Seq);
+	S.PinCount++;
+	S.LastAccess = ++AccessCount;
+	if (S.TracksPending)
+		LoadSequence(S);
+}
+
+
+void CAnimSet::UnpinSequence(const CMeshAnimSeq *Seq)
+{
+	if (!LazyLoad) return;
+	CMeshAnimSeq &S = GetSequence(Seq);
+	assert(S.PinCount > 0);
+	S.PinCount--;
+	// tracks remain loaded, they are unloaded by UnloadSequences() when required
+	S.LastAccess = ++AccessCount;
+}
+
+
+void CAnimSet::UnloadSequences(int Budget)
+{
+	while (ResidentSize > Budget)
+	{
+		CMeshAnimSeq *Oldest = NULL;
+		for (int i = 0; i < Sequences.Num(); i++)
+		{
+			CMeshAnimSeq &S = Sequences[i];
+			if (S.PinCount || S.TracksPending || !S.TrackDataSize) continue;
+			if (!Oldest || S.LastAccess < Oldest->LastAccess)
+				Oldest = &S;
+		}
+		if (!Oldest) break;						// everything else is in use
+		UnloadSequence(*Oldest);
+	}
+}
+
+
+void CAnimSet::LoadSequence(CMeshAnimSeq &S)
+{
+	guard(CAnimSet::LoadSequence);
+	MEM_TAG(MEM_Anim);
+
+	// free space for new sequence
+	if (MemoryBudget)
+		UnloadSequences(MemoryBudget - S.TrackDataSize);
+
+	assert(SourceAr);
+	CMappedFile &Ar = *SourceAr;
+	Ar.ArVer = SourceVersion;
+	Ar.SetStopper(0);
+	Ar.Seek(S.TrackDataOffset);
+	Ar << S.Tracks;
+	if (Ar.Tell() - S.TrackDataOffset != S.TrackDataSize)
+		appError("Wrong track data size");
+	S.TracksPending = false;
+	ResidentSize += S.TrackDataSize;
+
+	unguardf(("%s", *S.Name));
+}
+
+
+void CAnimSet::UnloadSequence(CMeshAnimSeq &S)
+{
+	assert(!S.TracksPending);
+	S.Tracks.Remove(0, S.Tracks.Num());
+	S.Tracks.Empty();
+	S.TracksPending = true;
+	ResidentSize -= S.TrackDataSize;
+}
+
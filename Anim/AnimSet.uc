@@ -35,18 +35,66 @@ struct AnalogTrack
 {
 	/** Rotation keys */
 	var() array<Quat>		KeyQuat;
-	/** Position keys */
+	/**
+	 * Position keys. Empty array means that position track was stripped, and
+	 * bone position should be taken from the SkeletalMesh reference pose.
+	 */
 	var() array<Vec3>		KeyPos;
 	/*!! TODO: Scale keys */
 	var() array<Vec3>		KeyScale;
-	/** Key times, in seconds */
+	/**
+	 * Key times, in frames. Key time is taken from the first non-empty array of KeyTime,
+	 * KeyFrame8 and KeyFrame16. When all these arrays are empty, keys are placed uniformly
+	 * with KeyStep interval.
+	 */
 	var() array<float>		KeyTime;
+	/** Compact key times, for reduced tracks with integer frame times */
+	var array<byte>			KeyFrame8;
+	var array<ushort>		KeyFrame16;
+	/** Interval between keys of uniformly sampled track, in frames */
+	var float				KeyStep;
 
 	structcpptext
 	{
+		/**
+		 * Number of keys in this track
+		 */
+		int GetNumKeys() const
+		{
+			if (KeyTime.Num())    return KeyTime.Num();
+			if (KeyFrame8.Num())  return KeyFrame8.Num();
+			if (KeyFrame16.Num()) return KeyFrame16.Num();
+			return max(KeyQuat.Num(), KeyPos.Num());
+		}
+		/**
+		 * Get time of specified key, in frames
+		 */
+		float GetKeyTime(int Index) const
+		{
+			if (KeyTime.Num())    return KeyTime[Index];
+			if (KeyFrame8.Num())  return KeyFrame8[Index];
+			if (KeyFrame16.Num()) return KeyFrame16[Index];
+			return Index * KeyStep;
+		}
+		/**
+		 * Size of key data, in bytes
+		 */
+		int GetKeysSize() const
+		{
+			return sizeof(CQuat) * KeyQuat.Num()
+				+  sizeof(CVec3) * KeyPos.Num()
+				+  sizeof(CVec3) * KeyScale.Num()
+				+  sizeof(float) * KeyTime.Num()
+				+  sizeof(byte)  * KeyFrame8.Num()
+				+  sizeof(word)  * KeyFrame16.Num();
+		}
+
 		friend CArchive& operator<<(CArchive &Ar, CAnalogTrack &T)
 		{
-			return Ar << T.KeyQuat << T.KeyPos << T.KeyScale << T.KeyTime;
+			Ar << T.KeyQuat << T.KeyPos << T.KeyScale << T.KeyTime;
+			if (Ar.ArVer >= 4)
+				Ar << T.KeyFrame8 << T.KeyFrame16 << T.KeyStep;
+			return Ar;
 		}
 	}
 };
@@ -79,9 +127,29 @@ struct MeshAnimSeq
 	var array<AnalogTrack>	Tracks;
 	/*!! TODO: Animation notifies */
 	var() array<AnimNotify>	Notifies;
+	/** Indices of shared tracks in AnimSet.TrackPool. When not empty, Tracks array is not used */
+	var array<int>			TrackRefs;
+	/** Pointer to AnimSet.TrackPool data, used together with TrackRefs */
+	var transient pointer<CAnalogTrack> PoolData;
+	/** Location of serialized Tracks in the source file (used for lazy loading) */
+	var transient int		TrackDataOffset;
+	var transient int		TrackDataSize;
+	/** True when Tracks were not loaded yet (lazy loading) */
+	var transient bool		TracksPending;
+	/** Value of AnimSet access counter at the last use of this sequence */
+	var transient int		LastAccess;
+	/** Number of users (mesh instance channels) of this sequence; pinned sequence is never unloaded */
+	var transient int		PinCount;
 
 	structcpptext
 	{
+		/**
+		 * Get track for specified bone: own track or shared one from AnimSet track pool
+		 */
+		const CAnalogTrack &GetTrack(int TrackIndex) const
+		{
+			return TrackRefs.Num() ? PoolData[TrackRefs[TrackIndex]] : Tracks[TrackIndex];
+		}
 		/**
 		 * Interpolate bone position from animation track for specified time
 		 */
@@ -100,23 +168,60 @@ struct MeshAnimSeq
 
 
 /** Bone name that each track relates to. TrackBoneName.Num() == Number of tracks. */
-var array<AnimBone>			TrackBoneName;
+var native array<AnimBone>	TrackBoneName;
 /** Actual animation sequence information */
-var array<MeshAnimSeq>		Sequences;
+var native array<MeshAnimSeq> Sequences;
+/** Tracks, shared between sequences (see MeshAnimSeq.TrackRefs) */
+var native array<AnalogTrack> TrackPool;
 /**
  *	Indicates that only the rotation should be taken from the animation sequence and the translation
  *  should come from the SkeletalMesh ref pose. Note that the root bone always takes translation from
  *  the animation, even if this flag is set.
  */
-var() bool					AnimRotationOnly;
+var() native bool			AnimRotationOnly;
+/** Tolerance, which was used for track pooling; tracks are pooled again with it after modification */
+var transient float			PoolTolerance;
 
 
 cpptext
 {
 	CAnimSet()
 	:	AnimRotationOnly(false)
+	,	PoolTolerance(0)
+	,	LazyLoad(false)
+	,	MemoryBudget(0)
+	,	ResidentSize(0)
+	,	AccessCount(0)
+	,	SourceVersion(0)
+	,	SourceAr(NULL)
 	{}
+	virtual ~CAnimSet();
 
+	/**
+	 * Load AnimSet with on-demand loading of sequences: only sequence headers are read
+	 * here, tracks will be loaded by PinSequence(). File remains mapped while AnimSet
+	 * exists. When MemoryBudget is not zero, least recently used sequences, which are
+	 * not pinned, will be unloaded when loading another sequence, to keep loaded track
+	 * data within this budget (in bytes). Returns NULL when file cannot be opened.
+	 */
+	static CAnimSet* LoadObjectLazy(const char *From, int MemoryBudget = 0);
+	/**
+	 * Load tracks for all sequences, which were not loaded yet. Required before saving
+	 * AnimSet, loaded with LoadObjectLazy().
+	 */
+	void LoadAllSequences();
+	/**
+	 * Register a user of sequence, and load its tracks if they were not loaded yet.
+	 * Sequence tracks will not be unloaded until UnpinSequence() is called by every
+	 * user. Does nothing for AnimSet, which is loaded completely.
+	 */
+	void PinSequence(const CMeshAnimSeq *Seq);
+	void UnpinSequence(const CMeshAnimSeq *Seq);
+	/**
+	 * Unload least recently used sequences, which are not pinned, until loaded track
+	 * data fits Budget bytes. Called automatically when sequence is loaded.
+	 */
+	void UnloadSequences(int Budget);
 	/**
 	 * Query size statistics about all animation sequences
 	 */
@@ -126,10 +231,27 @@ cpptext
 	 * found, returns NULL.
 	 */
 	const CMeshAnimSeq *FindAnim(const char *AnimName) const;
+	/**
+	 * Update pointers to TrackPool in all sequences; should be called after modification
+	 * of TrackPool array
+	 */
+	void LinkTrackPool();
 
-	virtual void Serialize(CArchive &Ar)
-	{
-		Super::Serialize(Ar);
-		Ar << TrackBoneName << Sequences << AnimRotationOnly;
-	}
+	virtual void Serialize(CArchive &Ar);
+
+protected:
+	/**
+	 * Lazy loading support
+	 */
+	bool			LazyLoad;
+	int				MemoryBudget;
+	int				ResidentSize;		// size of loaded track data
+	int				AccessCount;		// counter for LRU unloading
+	int				SourceVersion;		// ArVer of SourceFile
+	TString<256>	SourceFile;
+	class CMappedFile *SourceAr;		// SourceFile, mapped for loading of sequences
+
+	CMeshAnimSeq &GetSequence(const CMeshAnimSeq *Seq);
+	void LoadSequence(CMeshAnimSeq &S);
+	void UnloadSequence(CMeshAnimSeq &S);
 }
@@ -16,8 +16,8 @@ struct AnimControl
 };
 
 
-var array<AnimNode>		AllNodes;
-var array<AnimControl>	Controls;
+var native array<AnimNode>	AllNodes;
+var native array<AnimControl> Controls;
 
 
 cpptext
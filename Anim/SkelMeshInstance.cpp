@@ -42,6 +42,8 @@
 
 struct CMeshBoneData
 {
+	DECLARE_ALLOCATOR
+
 	// static data (computed after mesh loading)
 	int			BoneMap;			// index of bone in AnimSet
 
@@ -67,9 +69,8 @@ CSkelMeshInstance::~CSkelMeshInstance()
 {
 	if (pMesh)
 	{
+		ClearSkelAnims();				// unpin sequences
 		delete BoneData;
-		delete MeshVerts;
-		delete MeshNormals;
 	}
 }
 
@@ -79,6 +80,11 @@ void CSkelMeshInstance::ClearSkelAnims()
 	// init 1st animation channel with default pose
 	for (int i = 0; i < MAX_SKELANIMCHANNELS; i++)
 	{
+		if (pAnim)
+		{
+			SetChannelAnim(Channels[i].Anim1, NULL);
+			SetChannelAnim(Channels[i].Anim2, NULL);
+		}
 		Channels[i].Anim1          = NULL;
 		Channels[i].Anim2          = NULL;
 		Channels[i].SecondaryBlend = 0;
@@ -91,6 +97,7 @@ void CSkelMeshInstance::ClearSkelAnims()
 void CSkelMeshInstance::SetMesh(const CSkeletalMesh *Mesh)
 {
 	guard(CSkelMeshInstance::SetMesh);
+	MEM_TAG(MEM_Mesh);
 
 	bool prevMesh = pMesh != NULL;
 	pMesh = Mesh;
@@ -98,26 +105,11 @@ void CSkelMeshInstance::SetMesh(const CSkeletalMesh *Mesh)
 	// get some counts
 	int i;
 	int NumBones = pMesh->Skeleton.Num();
-	int NumVerts = pMesh->Lods[0].Points.Num();	// data for software skinning
-	for (i = 1; i < pMesh->Lods.Num(); i++)
-	{
-		if (NumVerts < pMesh->Lods[i].Points.Num())
-		{
-			appNotify("Mesh with LOD[%d] vertex count greater, than LOD[0]", i);
-			NumVerts = pMesh->Lods[i].Points.Num();
-		}
-	}
 
 	// allocate some arrays
 	if (prevMesh)
-	{
 		delete BoneData;
-		delete MeshVerts;
-		delete MeshNormals;
-	}
 	BoneData    = new CMeshBoneData[NumBones];
-	MeshVerts   = new CVec3        [NumVerts];
-	MeshNormals = new CVec3        [NumVerts];
 
 	CMeshBoneData *data;
 	for (i = 0, data = BoneData; i < NumBones; i++, data++)
@@ -135,19 +127,22 @@ void CSkelMeshInstance::SetMesh(const CSkeletalMesh *Mesh)
 }
 
 
-void CSkelMeshInstance::SetAnim(const CAnimSet *Anim)
+void CSkelMeshInstance::SetAnim(CAnimSet *Anim)
 {
 	if (!pMesh) return;				// may be, bad mesh ... should revise for multi-mesh support
+	MEM_TAG(MEM_Anim);
 
+	// release sequences of previous AnimSet
+	ClearSkelAnims();
 	pAnim = Anim;
 //??	assert(pMesh);
-	assert(pAnim);
 
 	// prepare animation <-> mesh bone map
 	for (int i = 0; i < pMesh->Skeleton.Num(); i++)
 	{
 		const CMeshBone &B = pMesh->Skeleton[i];
 		BoneData[i].BoneMap = -1;
+		if (!pAnim) continue;
 		// find reference bone in animation track
 		for (int j = 0; j < pAnim->TrackBoneName.Num(); j++)
 			if (!stricmp(B.Name, pAnim->TrackBoneName[j].Name))	// case-insensitive compare
@@ -173,6 +168,17 @@ const CMeshAnimSeq *CSkelMeshInstance::FindAnim(const char *AnimName) const
 }
 
 
+// assign sequence to channel slot (Anim1 or Anim2); AnimSet should not unload
+// sequences, which are used by channels
+void CSkelMeshInstance::SetChannelAnim(const CMeshAnimSeq *&Slot, const CMeshAnimSeq *Seq)
+{
+	if (Slot == Seq) return;
+	if (Seq)  pAnim->PinSequence(Seq);
+	if (Slot) pAnim->UnpinSequence(Slot);
+	Slot = Seq;
+}
+
+
 void CSkelMeshInstance::SetBoneScale(const char *BoneName, float scale)
 {
 	guard(CSkelMeshInstance::SetBoneScale);
@@ -233,6 +239,10 @@ void CSkelMeshInstance::UpdateSkeleton()
 			continue;
 		// NOTE: if Stage==0 and animation is not assigned, we will get here anyway
 
+		// sequences of channels are pinned, so their tracks are loaded
+		assert(!Chn->Anim1 || !Chn->Anim1->TracksPending);
+		assert(!Chn->Anim2 || !Chn->Anim2->TracksPending);
+
 		float Time2;
 		if (Chn->Anim1 && Chn->Anim2 && Chn->SecondaryBlend)
 		{
@@ -269,6 +279,8 @@ void CSkelMeshInstance::UpdateSkeleton()
 			// compute bone orientation
 			if (Chn->Anim1 && BoneIndex >= 0)
 			{
+				// stripped position tracks will not modify BP: use refpose position
+				BP = B.Position;
 				// get bone position from track
 				if (!Chn->Anim2 || Chn->SecondaryBlend != 1.0f)
 				{
@@ -280,7 +292,7 @@ void CSkelMeshInstance::UpdateSkeleton()
 				// blend secondary animation
 				if (Chn->Anim2 && Chn->SecondaryBlend > 0.0f)
 				{
-					CVec3 BP2;
+					CVec3 BP2 = B.Position;
 					CQuat BO2;
 #if SHOW_BONE_UPDATES
 					BoneUpdateCounts[i]++;
@@ -467,6 +479,11 @@ void CSkelMeshInstance::PlayAnimInternal(const char *AnimName, float Rate, float
 	if (!NewAnim)
 	{
 		// show default pose
+		if (pAnim)
+		{
+			SetChannelAnim(Chn.Anim1, NULL);
+			SetChannelAnim(Chn.Anim2, NULL);
+		}
 		Chn.Anim1          = NULL;
 		Chn.Anim2          = NULL;
 		Chn.Time           = 0;
@@ -486,8 +503,8 @@ void CSkelMeshInstance::PlayAnimInternal(const char *AnimName, float Rate, float
 		return;
 	}
 
-	Chn.Anim1          = NewAnim;
-	Chn.Anim2          = NULL;
+	SetChannelAnim(Chn.Anim1, NewAnim);
+	SetChannelAnim(Chn.Anim2, NULL);
 	Chn.Time           = 0;
 	Chn.SecondaryBlend = 0;
 	Chn.TweenTime      = TweenTime;
@@ -526,7 +543,7 @@ void CSkelMeshInstance::SetSecondaryAnim(int Channel, const char *AnimName)
 {
 	guard(CSkelMeshInstance::SetSecondaryAnim);
 	CAnimChan &Chn = GetStage(Channel);
-	Chn.Anim2          = FindAnim(AnimName);
+	SetChannelAnim(Chn.Anim2, FindAnim(AnimName));
 	Chn.SecondaryBlend = 0;
 	unguard;
 }
@@ -685,7 +702,11 @@ void CSkelMeshInstance::DrawMesh(bool Wireframe, bool Normals, bool Texturing)
 		glMaterialf(GL_FRONT, GL_SHININESS, 12);
 	}
 
-	// transform verts
+	// transform verts; vertex buffers are used for this draw call only, align
+	// them to cache line for streaming writes
+	CScratchScope Scratch;
+	CVec3 *MeshVerts   = NewScratch<CVec3>(Lod.Points.Num(), CACHE_LINE_SIZE);
+	CVec3 *MeshNormals = NewScratch<CVec3>(Lod.Points.Num(), CACHE_LINE_SIZE);
 	for (i = 0; i < Lod.Points.Num(); i++)
 	{
 		CCoords Transform;
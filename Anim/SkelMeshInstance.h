@@ -26,11 +26,13 @@ class CSkelMeshInstance
 	};
 
 public:
+	DECLARE_ALLOCATOR
+
 	// mesh state
 	int					LodNum;
 	// linked data
 	const CSkeletalMesh	*pMesh;
-	const CAnimSet		*pAnim;
+	CAnimSet			*pAnim;
 
 	CSkelMeshInstance()
 	:	LodNum(-1)
@@ -38,8 +40,6 @@ public:
 	,	pAnim(NULL)
 	,	MaxAnimChannel(-1)
 	,	BoneData(NULL)
-	,	MeshVerts(NULL)
-	,	MeshNormals(NULL)
 	{
 		ClearSkelAnims();
 	}
@@ -47,7 +47,12 @@ public:
 	virtual ~CSkelMeshInstance();
 
 	void SetMesh(const CSkeletalMesh *Mesh);
-	void SetAnim(const CAnimSet *Anim);
+	/**
+	 * Link AnimSet to the mesh and reset animation channels. Sequences, used by
+	 * channels, are pinned in AnimSet, so AnimSet should be detached with SetAnim(NULL)
+	 * or instance should be destroyed before AnimSet is released.
+	 */
+	void SetAnim(CAnimSet *Anim);
 
 	void ClearSkelAnims();
 //??	void StopAnimating(bool ClearAllButBase);
@@ -97,7 +102,7 @@ public:
 
 	bool HasAnim(const char *AnimName) const
 	{
-		return FindAnim(AnimName) >= 0;
+		return FindAnim(AnimName) != NULL;
 	}
 	bool IsAnimating(int Channel = 0);
 	bool IsTweening(int Channel = 0)
@@ -143,8 +148,6 @@ public:
 protected:
 	// mesh data
 	struct CMeshBoneData *BoneData;
-	CVec3		*MeshVerts;			//!! combine with MeshNormals
-	CVec3		*MeshNormals;
 	// animation state
 	CAnimChan	Channels[MAX_SKELANIMCHANNELS];
 	int			MaxAnimChannel;
@@ -160,6 +163,7 @@ protected:
 		return Channels[StageIndex];
 	}
 	const CMeshAnimSeq *FindAnim(const char *AnimName) const;
+	void SetChannelAnim(const CMeshAnimSeq *&Slot, const CMeshAnimSeq *Seq);
 	void PlayAnimInternal(const char *AnimName, float Rate, float TweenTime, int Channel, bool Looped);
 	void UpdateSkeleton();
 };
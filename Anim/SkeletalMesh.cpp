@@ -150,7 +150,8 @@ void CSkeletalMesh::PostLoad()
 	if (!numBones) return;	// empty skeleton, just created
 
 	// compute reference bone inverted coords
-	CCoords RefCoords[MAX_MESH_BONES];
+	CScratchScope Scratch;
+	CCoords *RefCoords = NewScratch<CCoords>(numBones);
 	for (i = 0; i < numBones; i++)
 	{
 		CMeshBone &B = Skeleton[i];
@@ -176,9 +177,10 @@ void CSkeletalMesh::PostLoad()
 
 	// check bones tree
 	// get bone subtree sizes
-	int treeSizes[MAX_MESH_BONES], depth[MAX_MESH_BONES];
+	int *treeSizes = NewScratch<int>(numBones);
+	int *depth     = NewScratch<int>(numBones);
 	int numIndices = 0;
-	CheckBoneTree(Skeleton, 0, treeSizes, depth, numIndices, MAX_MESH_BONES);
+	CheckBoneTree(Skeleton, 0, treeSizes, depth, numIndices, numBones);
 	assert(numIndices == numBones);
 	for (i = 0; i < numBones; i++)
 		Skeleton[i].SubtreeSize = treeSizes[i];	// remember subtree size
@@ -236,9 +238,12 @@ int CSkeletalMesh::FindBone(const char *BoneName) const
 void CSkeletalMesh::DumpBones()
 {
 #if 1
-	int treeSizes[MAX_MESH_BONES], depth[MAX_MESH_BONES];
+	if (!Skeleton.Num()) return;
+	CScratchScope Scratch;
+	int *treeSizes = NewScratch<int>(Skeleton.Num());
+	int *depth     = NewScratch<int>(Skeleton.Num());
 	int numIndices = 0;
-	CheckBoneTree(Skeleton, 0, treeSizes, depth, numIndices, MAX_MESH_BONES);
+	CheckBoneTree(Skeleton, 0, treeSizes, depth, numIndices, Skeleton.Num());
 	//?? NOTE: DEPTH INFORMATION can be easily computed (simple loop by parent index)
 	for (int i = 0; i < numIndices; i++)
 	{
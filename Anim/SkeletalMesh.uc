@@ -16,7 +16,7 @@ const ANIM_EXTENSION		= "ska";
 
 
 
-struct PointWeight
+struct immutable PointWeight
 {
 	/** NO_INFLUENCE == entry not used */
 	var short   			BoneIndex;
@@ -36,7 +36,7 @@ struct PointWeight
 /**
  * Rendering vertex structure
  */
-struct MeshPoint
+struct immutable MeshPoint
 {
 	var Vec3				Point;
 	var Vec3				Normal;
@@ -64,8 +64,8 @@ struct MeshBone
 	var() editconst int		ParentIndex;
 
 	/** following data generated after mesh loading */
-	var   Coords			InvRefCoords;
-	var   int				SubtreeSize;
+	var transient Coords	InvRefCoords;
+	var transient int		SubtreeSize;
 
 	structcpptext
 	{
@@ -179,19 +179,19 @@ struct SkeletalMeshLod
 
 
 /** Origin in original coordinate system */
-var(Orientation)	Vec3	MeshOrigin;
+var(Orientation) native Vec3 MeshOrigin;
 /** Amount to scale mesh when importing */
-var(Orientation)	Vec3	MeshScale;
+var(Orientation) native Vec3 MeshScale;
 /** Amount to rotate when importing */
-var(Orientation)	Rotator	RotOrigin;
+var(Orientation) native Rotator RotOrigin;
 /** Information for LOD levels */
-var() editnoadd		array<SkeletalMeshLod> Lods;
+var() editnoadd native array<SkeletalMeshLod> Lods;
 /** Skeleton bones */
-var					array<MeshBone> Skeleton;
+var native			array<MeshBone> Skeleton;
 /** Collision volumes */
-var(Extra Data) editnoadd array<MeshHitBox> BoundingBoxes;
+var(Extra Data) editnoadd native array<MeshHitBox> BoundingBoxes;
 /** Attachment sockets */
-var(Extra Data) editnoadd array<MeshSocket> Sockets;
+var(Extra Data) editnoadd native array<MeshSocket> Sockets;
 
 
 struct MeshMaterial
@@ -218,15 +218,15 @@ struct MeshMaterial
 /**
  * List of materials applied to this mesh
  */
-var() editfixedsize array<MeshMaterial> Materials;
+var() editfixedsize native array<MeshMaterial> Materials;
 
 
 /**
  * Following data generated after loading
  */
 
-var Coords BaseTransform;
-var Coords BaseTransformScaled;
+var transient Coords BaseTransform;
+var transient Coords BaseTransformScaled;
 
 
 cpptext
@@ -0,0 +1,403 @@
+#include "Core.h"
+#include "Compression.h"
+#include "FileReaderMem.h"
+
+
+/*-----------------------------------------------------------------------------
+	LZ coder
+
+	Compressed block is a sequence of commands:
+		byte	Token				high 4 bits: literal count, low 4 bits: match
+									length - MIN_MATCH; value 15 means extended length
+		...		LiteralCount		extension: bytes added to 15, until byte != 255
+		...		Literals
+		word	Offset				match distance (absent in the last command)
+		...		MatchLength			extension
+	Last command has literals only, and ends at the end of block.
+-----------------------------------------------------------------------------*/
+
+#define MIN_MATCH			4
+#define MAX_OFFSET			65535
+#define LZ_HASH_BITS		14
+#define LZ_HASH_SIZE		(1 << LZ_HASH_BITS)
+
+
+static FORCEINLINE unsigned Read32(const byte *p)
+{
+	unsigned v;
+	memcpy(&v, p, 4);
+	return v;
+}
+
+static FORCEINLINE int LZHash(unsigned v)
+{
+	return (v * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+// store extended length; returns NULL on output overflow
+static FORCEINLINE byte* PutLength(byte *Dst, const byte *DstEnd, int Len)
+{
+	for ( ; Len >= 255; Len -= 255)
+	{
+		if (Dst >= DstEnd) return NULL;
+		*Dst++ = 255;
+	}
+	if (Dst >= DstEnd) return NULL;
+	*Dst++ = Len;
+	return Dst;
+}
+
+// write command; Offset is 0 for the last command
+static byte* PutCommand(byte *Dst, const byte *DstEnd, const byte *Literals, int NumLiterals, int Offset, int MatchLen)
+{
+	if (Dst >= DstEnd) return NULL;
+	byte *Token = Dst++;
+	int ml = Offset ? MatchLen - MIN_MATCH : 0;
+	*Token = (min(NumLiterals, 15) << 4) | min(ml, 15);
+	if (NumLiterals >= 15 && !(Dst = PutLength(Dst, DstEnd, NumLiterals - 15)))
+		return NULL;
+	if (Dst + NumLiterals > DstEnd) return NULL;
+	memcpy(Dst, Literals, NumLiterals);
+	Dst += NumLiterals;
+	if (!Offset) return Dst;
+	if (Dst + 2 > DstEnd) return NULL;
+	Dst[0] = Offset & 0xFF;
+	Dst[1] = Offset >> 8;
+	Dst += 2;
+	if (ml >= 15 && !(Dst = PutLength(Dst, DstEnd, ml - 15)))
+		return NULL;
+	return Dst;
+}
+
+
+int appCompressLZ(const byte *Src, int SrcSize, byte *Dst, int DstSize)
+{
+	int HashTable[LZ_HASH_SIZE];
+	memset(HashTable, -1, sizeof(HashTable));
+
+	const byte *DstEnd  = Dst + DstSize;
+	byte *Out           = Dst;
+	const byte *Literal = Src;				// start of pending literals
+	const byte *p       = Src;
+	const byte *SrcEnd  = Src + SrcSize;
+	const byte *MatchLimit = SrcEnd - MIN_MATCH;
+
+	while (p <= MatchLimit)
+	{
+		unsigned v = Read32(p);
+		int h = LZHash(v);
+		int Prev = HashTable[h];
+		HashTable[h] = p - Src;
+		if (Prev < 0 || (p - Src) - Prev > MAX_OFFSET || Read32(Src + Prev) != v)
+		{
+			p++;
+			continue;
+		}
+		// found a match, extend it
+		const byte *m = Src + Prev;
+		int Len = MIN_MATCH;
+		while (p + Len < SrcEnd && p[Len] == m[Len])
+			Len++;
+		Out = PutCommand(Out, DstEnd, Literal, p - Literal, p - m, Len);
+		if (!Out) return 0;
+		// register a position inside of match for better ratio on repeated data
+		if (p + Len - 2 <= MatchLimit)
+			HashTable[LZHash(Read32(p + Len - 2))] = p + Len - 2 - Src;
+		p += Len;
+		Literal = p;
+	}
+	Out = PutCommand(Out, DstEnd, Literal, SrcEnd - Literal, 0, 0);
+	if (!Out) return 0;
+	return Out - Dst;
+}
+
+
+// read extended length; returns false on damaged data
+static FORCEINLINE bool GetLength(const byte *&Src, const byte *SrcEnd, int &Len)
+{
+	byte b;
+	do
+	{
+		if (Src >= SrcEnd) return false;
+		b = *Src++;
+		Len += b;
+	} while (b == 255);
+	return true;
+}
+
+
+bool appDecompressLZ(const byte *Src, int SrcSize, byte *Dst, int DstSize)
+{
+	const byte *SrcEnd = Src + SrcSize;
+	byte *Out          = Dst;
+	byte *DstEnd       = Dst + DstSize;
+
+	while (Src < SrcEnd)
+	{
+		int Token = *Src++;
+		// literals
+		int NumLiterals = Token >> 4;
+		if (NumLiterals == 15 && !GetLength(Src, SrcEnd, NumLiterals))
+			return false;
+		if (NumLiterals > SrcEnd - Src || NumLiterals > DstEnd - Out)
+			return false;
+		memcpy(Out, Src, NumLiterals);
+		Out += NumLiterals;
+		Src += NumLiterals;
+		if (Src == SrcEnd) break;				// last command
+		// match
+		if (Src + 2 > SrcEnd) return false;
+		int Offset = Src[0] | (Src[1] << 8);
+		Src += 2;
+		int Len = Token & 15;
+		if (Len == 15 && !GetLength(Src, SrcEnd, Len))
+			return false;
+		Len += MIN_MATCH;
+		if (Offset == 0 || Offset > Out - Dst || Len > DstEnd - Out)
+			return false;
+		const byte *m = Out - Offset;
+		if (Offset >= Len)
+		{
+			memcpy(Out, m, Len);
+			Out += Len;
+		}
+		else
+		{
+			// overlapped copy (repeated pattern)
+			for (int i = 0; i < Len; i++)
+				*Out++ = *m++;
+		}
+	}
+	return Out == DstEnd;
+}
+
+
+/*-----------------------------------------------------------------------------
+	Delta + transpose filter
+-----------------------------------------------------------------------------*/
+
+void appDeltaTransposeFilter(const byte *Src, byte *Dst, int Size, int Stride)
+{
+	int Count = Size / 4;
+	for (int i = 0; i < Count; i++)
+	{
+		unsigned d = Read32(Src + i * 4);
+		if (i >= Stride)
+			d -= Read32(Src + (i - Stride) * 4);
+		Dst[i]             = d & 0xFF;
+		Dst[i + Count]     = (d >> 8) & 0xFF;
+		Dst[i + Count * 2] = (d >> 16) & 0xFF;
+		Dst[i + Count * 3] = d >> 24;
+	}
+	// unaligned tail is not filtered
+	memcpy(Dst + Count * 4, Src + Count * 4, Size - Count * 4);
+}
+
+
+void appDeltaTransposeUnfilter(const byte *Src, byte *Dst, int Size, int Stride)
+{
+	int Count = Size / 4;
+	for (int i = 0; i < Count; i++)
+	{
+		unsigned v = Src[i] | (Src[i + Count] << 8) | (Src[i + Count * 2] << 16) | (Src[i + Count * 3] << 24);
+		if (i >= Stride)
+			v += Read32(Dst + (i - Stride) * 4);
+		memcpy(Dst + i * 4, &v, 4);
+	}
+	memcpy(Dst + Count * 4, Src + Count * 4, Size - Count * 4);
+}
+
+
+/*-----------------------------------------------------------------------------
+	Block stream
+	Layout:
+		int		NumBlocks
+		int		BlockInfo[NumBlocks]	packed size | (method << 24)
+		...		block data
+	All blocks except the last one has COMPRESS_BLOCK_SIZE bytes of original data.
+-----------------------------------------------------------------------------*/
+
+// block methods; filtered blocks has method BLOCK_FILTER_LZ + Stride - 1
+#define BLOCK_STORED		0
+#define BLOCK_LZ			1
+#define BLOCK_FILTER_LZ		2
+
+#define BLOCK_SIZE_MASK		0x00FFFFFF
+#define BLOCK_METHOD_SHIFT	24
+
+// structure strides (in 4-byte values), tried by filter: float streams, CVec3,
+// CQuat, vertices (CMeshPoint is 12 values)
+static const int FilterStrides[] = { 1, 3, 4, 6, 8, 12 };
+
+
+struct CCompressBlocks
+{
+	const byte		*Data;
+	int				Size;
+	int				Flags;
+	byte			*Packed;			// COMPRESS_BLOCK_SIZE per block
+	int				*Info;
+};
+
+
+static void CompressBlock(int Index, void *Param)
+{
+	guard(CompressBlock);
+
+	CCompressBlocks &Ctx = *(CCompressBlocks*)Param;
+	const byte *Src = Ctx.Data + Index * COMPRESS_BLOCK_SIZE;
+	int SrcSize     = min(Ctx.Size - Index * COMPRESS_BLOCK_SIZE, COMPRESS_BLOCK_SIZE);
+	byte *Dst       = Ctx.Packed + Index * COMPRESS_BLOCK_SIZE;
+
+	// store block, when compression will not help
+	int BestSize   = SrcSize;
+	int BestMethod = BLOCK_STORED;
+	memcpy(Dst, Src, SrcSize);
+
+	byte *Tmp = (byte*)appMallocNoInit(SrcSize * 2);
+	if (Ctx.Flags & COMPRESS_LZ)
+	{
+		int PackedSize = appCompressLZ(Src, SrcSize, Tmp, BestSize - 1);
+		if (PackedSize)
+		{
+			memcpy(Dst, Tmp, PackedSize);
+			BestSize   = PackedSize;
+			BestMethod = BLOCK_LZ;
+		}
+	}
+	if (Ctx.Flags & COMPRESS_FILTER)
+	{
+		byte *Filtered = Tmp + SrcSize;
+		for (int i = 0; i < (int)ARRAY_COUNT(FilterStrides); i++)
+		{
+			int Stride = FilterStrides[i];
+			appDeltaTransposeFilter(Src, Filtered, SrcSize, Stride);
+			int PackedSize = appCompressLZ(Filtered, SrcSize, Tmp, BestSize - 1);
+			if (PackedSize)
+			{
+				memcpy(Dst, Tmp, PackedSize);
+				BestSize   = PackedSize;
+				BestMethod = BLOCK_FILTER_LZ + Stride - 1;
+			}
+		}
+	}
+	appFree(Tmp);
+
+	Ctx.Info[Index] = BestSize | (BestMethod << BLOCK_METHOD_SHIFT);
+
+	unguardf(("%d", Index));
+}
+
+
+void appCompressBlocks(const byte *Data, int Size, TArray<byte> &Out, int Flags)
+{
+	guard(appCompressBlocks);
+
+	int NumBlocks = (Size + COMPRESS_BLOCK_SIZE - 1) / COMPRESS_BLOCK_SIZE;
+	CCompressBlocks Ctx;
+	Ctx.Data   = Data;
+	Ctx.Size   = Size;
+	Ctx.Flags  = Flags;
+	Ctx.Packed = (byte*)appMallocNoInit(max(Size, 1));
+	Ctx.Info   = (int*)appMallocNoInit(max(NumBlocks, 1) * sizeof(int));
+	appParallelFor(NumBlocks, CompressBlock, &Ctx);
+
+	// build output stream
+	CArchiveMem Ar;
+	Ar << NumBlocks;
+	int i;
+	for (i = 0; i < NumBlocks; i++)
+		Ar << Ctx.Info[i];
+	for (i = 0; i < NumBlocks; i++)
+		Ar.Serialize(Ctx.Packed + i * COMPRESS_BLOCK_SIZE, Ctx.Info[i] & BLOCK_SIZE_MASK);
+	appFree(Ctx.Packed);
+	appFree(Ctx.Info);
+
+	int OutSize = Ar.GetDataSize();
+	Out.Empty(OutSize);
+	Out.AddNoInit(OutSize);
+	if (OutSize) memcpy(&Out[0], Ar.GetData(), OutSize);
+
+	unguard;
+}
+
+
+struct CDecompressBlocks
+{
+	const byte		*Src;
+	byte			*Dst;
+	int				DstSize;
+	const int		*Info;
+	const int		*Offsets;			// position of block data in Src
+	volatile int	Damaged;
+};
+
+
+static void DecompressBlock(int Index, void *Param)
+{
+	CDecompressBlocks &Ctx = *(CDecompressBlocks*)Param;
+	const byte *Src = Ctx.Src + Ctx.Offsets[Index];
+	int SrcSize     = Ctx.Info[Index] & BLOCK_SIZE_MASK;
+	int Method      = (unsigned)Ctx.Info[Index] >> BLOCK_METHOD_SHIFT;
+	byte *Dst       = Ctx.Dst + Index * COMPRESS_BLOCK_SIZE;
+	int DstSize     = min(Ctx.DstSize - Index * COMPRESS_BLOCK_SIZE, COMPRESS_BLOCK_SIZE);
+
+	bool ok = false;
+	if (Method == BLOCK_STORED)
+	{
+		if (SrcSize == DstSize)
+		{
+			memcpy(Dst, Src, DstSize);
+			ok = true;
+		}
+	}
+	else if (Method == BLOCK_LZ)
+	{
+		ok = appDecompressLZ(Src, SrcSize, Dst, DstSize);
+	}
+	else
+	{
+		byte *Tmp = (byte*)appMallocNoInit(DstSize);
+		ok = appDecompressLZ(Src, SrcSize, Tmp, DstSize);
+		if (ok) appDeltaTransposeUnfilter(Tmp, Dst, DstSize, Method - BLOCK_FILTER_LZ + 1);
+		appFree(Tmp);
+	}
+	if (!ok) Ctx.Damaged = 1;
+}
+
+
+void appDecompressBlocks(const byte *Src, int SrcSize, byte *Dst, int DstSize)
+{
+	guard(appDecompressBlocks);
+
+	CArchiveMem Ar(Src, SrcSize);
+	int NumBlocks;
+	Ar << NumBlocks;
+	if (NumBlocks != (DstSize + COMPRESS_BLOCK_SIZE - 1) / COMPRESS_BLOCK_SIZE)
+		appError("Wrong compressed block count");
+	TArray<int> Info, Offsets;
+	Info.Add(NumBlocks);
+	Info.SerializeItems(Ar);
+	Offsets.Add(NumBlocks);
+	int Pos = Ar.Tell();
+	for (int i = 0; i < NumBlocks; i++)
+	{
+		Offsets[i] = Pos;
+		Pos += Info[i] & BLOCK_SIZE_MASK;
+	}
+	if (Pos != SrcSize)
+		appError("Wrong compressed data size");
+
+	CDecompressBlocks Ctx;
+	Ctx.Src     = Src;
+	Ctx.Dst     = Dst;
+	Ctx.DstSize = DstSize;
+	Ctx.Info    = NumBlocks ? &Info[0] : NULL;
+	Ctx.Offsets = NumBlocks ? &Offsets[0] : NULL;
+	Ctx.Damaged = 0;
+	appParallelFor(NumBlocks, DecompressBlock, &Ctx);
+	if (Ctx.Damaged)
+		appError("Compressed data is damaged");
+
+	unguard;
+}
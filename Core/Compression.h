@@ -0,0 +1,48 @@
+#ifndef __COMPRESSION_H__
+#define __COMPRESSION_H__
+
+
+/*-----------------------------------------------------------------------------
+	Block compression
+-----------------------------------------------------------------------------*/
+
+// compression flags
+#define COMPRESS_NONE			0
+#define COMPRESS_LZ				1		// LZ77 byte coder
+#define COMPRESS_FILTER			2		// try delta + transpose filter for float/int streams
+
+// size of independently compressed block
+#define COMPRESS_BLOCK_SIZE		(256*1024)
+
+/**
+ * Compress single block with LZ coder. Returns compressed size, or 0 when data
+ * could not be compressed into DstSize bytes.
+ */
+int appCompressLZ(const byte *Src, int SrcSize, byte *Dst, int DstSize);
+/**
+ * Decompress single block. Returns false when data is damaged, or decompressed
+ * size is not equal to DstSize.
+ */
+bool appDecompressLZ(const byte *Src, int SrcSize, byte *Dst, int DstSize);
+
+/**
+ * Filter for arrays of structures with 4-byte fields (floats, ints): stores difference
+ * of the same field in neighbouring structures, then groups bytes of the same
+ * significance together. 'Stride' is structure size in 4-byte values.
+ */
+void appDeltaTransposeFilter(const byte *Src, byte *Dst, int Size, int Stride);
+void appDeltaTransposeUnfilter(const byte *Src, byte *Dst, int Size, int Stride);
+
+/**
+ * Compress data of any size. Data is split into COMPRESS_BLOCK_SIZE blocks, which
+ * are processed in parallel. Result is self-contained: it has sizes of all blocks.
+ */
+void appCompressBlocks(const byte *Data, int Size, TArray<byte> &Out, int Flags = COMPRESS_LZ);
+/**
+ * Decompress data, produced by appCompressBlocks(). DstSize should be equal to size
+ * of original data. Calls appError() for damaged data.
+ */
+void appDecompressBlocks(const byte *Src, int SrcSize, byte *Dst, int DstSize);
+
+
+#endif // __COMPRESSION_H__
@@ -3,6 +3,9 @@
 #include <windows.h>
 #else
 #include <unistd.h>					// syscalls
+#include <pthread.h>
+#include <semaphore.h>
+#include <errno.h>
 #endif
 
 #include "Core.h"
@@ -13,11 +16,52 @@ TString<128> GRootDir;
 
 /*-----------------------------------------------------------------------------
 	Log output
+	appPrintf() and appNotify() do not write to output devices directly: formatted
+	text is placed into a ring buffer, and a background thread passes it to devices.
+	Producers reserve space in the buffer with atomic increment of LogWritePos and
+	publish a record by writing its header; consumer processes published records
+	in order, clears their space and advances LogReadPos. Consumer is the logger
+	thread, or any thread, which is calling appFlushLog() or has found the buffer
+	full; devices are accessed only inside DrainLog(), under LogLock.
 -----------------------------------------------------------------------------*/
 
 #define MAX_LOGGERS		32
 #define BUFFER_LEN		16384		// allocated in stack, so - not very small, but not too large ...
 
+#define LOG_BUFFER_SIZE	(256*1024)	// power of 2, should fit a few BUFFER_LEN records
+#define LOG_BATCH_SIZE	16384		// text of consequent records is passed to devices with a single Write()
+#define LOG_NOTIFY		0x40000000	// record flag: text for notify.log
+
+// protects list of loggers, output devices and notify header; log functions may
+// be called from worker threads
+static CCriticalSection LogLock;
+
+// record: int header (text length | flags, 0 = not published yet), text without
+// trailing zero, padded to int size
+static int			LogBuffer[LOG_BUFFER_SIZE / sizeof(int)];
+static volatile int	LogWritePos = 0;
+static volatile int	LogReadPos = 0;
+static bool			Draining = false;
+static FILE			*NotifyFile = NULL;
+
+// logger thread
+enum
+{
+	LOGGER_NONE,					// not started yet
+	LOGGER_RUNNING,
+	LOGGER_SYNC,					// could not be started, or stopped at exit: producers drain buffer themselves
+};
+static volatile int	LoggerState = LOGGER_NONE;
+static volatile int	LoggerQuit = 0;
+static volatile int	LoggerSleeping = 0;
+#if _WIN32
+static HANDLE		LoggerSemaphore;
+static HANDLE		LoggerThreadHandle;
+#else
+static sem_t		LoggerSemaphore;
+static pthread_t	LoggerThreadHandle;
+#endif
+
 
 /*-----------------------------------------------------------------------------
 	NULL device
@@ -39,20 +83,15 @@ static COutputDeviceNull GNullDevice;
 
 class COutputDeviceLog : public COutputDevice
 {
-private:
-	int recurse;
-
 public:
 	virtual void Write(const char *str)
 	{
+		CCriticalSectionScope Lock(LogLock);
 		// do not allow GLog to be used in appPrintf() output device chains
 		// in this case, GLog.Write -> appPrintf -> GLog.Write
-		if (recurse)
+		if (Draining)
 			appError("GLog: recurse");
-		// print data
-		recurse++;
 		appPrintf("%s", str);
-		recurse--;
 	}
 };
 
@@ -73,14 +112,20 @@ void COutputDevice::Printf(const char *fmt, ...)
 	va_end(argptr);
 	if (len < 0 || len >= sizeof(buf) - 1) return;		//?? may be, write anyway
 
+	CCriticalSectionScope Lock(LogLock);
 	Write(buf);
 	if (FlushEveryTime) Flush();
 	unguard;
 }
 
 
+static void DrainLog();
+
 void COutputDevice::Register()
 {
+	CCriticalSectionScope Lock(LogLock);
+	// text, which was logged before registration, should not appear in this device
+	DrainLog();
 	if (numDevices)
 	{
 		for (int i = 0; i < numDevices; i++)
@@ -97,6 +142,9 @@ void COutputDevice::Register()
 
 void COutputDevice::Unregister()
 {
+	CCriticalSectionScope Lock(LogLock);
+	// pass pending text to the device before unregistering
+	DrainLog();
 	for (int i = 0; i < numDevices; i++)
 		if (loggers[i] == this)
 		{
@@ -109,6 +157,292 @@ void COutputDevice::Unregister()
 }
 
 
+/*-----------------------------------------------------------------------------
+	Log ring buffer
+-----------------------------------------------------------------------------*/
+
+static void CopyToRing(int Pos, const char *Data, int Size)
+{
+	char *Buffer = (char*)LogBuffer;
+	Pos &= LOG_BUFFER_SIZE - 1;
+	int Part = min(Size, LOG_BUFFER_SIZE - Pos);
+	memcpy(Buffer + Pos, Data, Part);
+	if (Part < Size)
+		memcpy(Buffer, Data + Part, Size - Part);	// wrap around
+}
+
+
+static void CopyFromRing(int Pos, char *Data, int Size)
+{
+	const char *Buffer = (char*)LogBuffer;
+	Pos &= LOG_BUFFER_SIZE - 1;
+	int Part = min(Size, LOG_BUFFER_SIZE - Pos);
+	memcpy(Data, Buffer + Pos, Part);
+	if (Part < Size)
+		memcpy(Data + Part, Buffer, Size - Part);
+}
+
+
+static void ClearRing(int Pos, int Size)
+{
+	char *Buffer = (char*)LogBuffer;
+	Pos &= LOG_BUFFER_SIZE - 1;
+	int Part = min(Size, LOG_BUFFER_SIZE - Pos);
+	memset(Buffer + Pos, 0, Part);
+	if (Part < Size)
+		memset(Buffer, 0, Size - Part);
+}
+
+
+static FORCEINLINE int GetRecordSize(int Len)
+{
+	return Align(Len + sizeof(int), sizeof(int));
+}
+
+
+// returns false when buffer has no space for the record
+static bool PushRecord(const char *Text, int Len, int Flags)
+{
+	int Size = GetRecordSize(Len);
+	int Pos;
+	while (true)
+	{
+		Pos = LogWritePos;
+		if ((unsigned)(Pos + Size - LogReadPos) > LOG_BUFFER_SIZE)
+			return false;
+		if (appInterlockedCompareExchange(&LogWritePos, Pos + Size, Pos) == Pos)
+			break;
+	}
+	CopyToRing(Pos + sizeof(int), Text, Len);
+	// publish the record
+	appInterlockedExchange(&LogBuffer[(Pos & (LOG_BUFFER_SIZE - 1)) / sizeof(int)], Len | Flags);
+	return true;
+}
+
+
+static void WriteDevices(const char *Text)
+{
+	for (int i = 0; i < numDevices; i++)
+	{
+		COutputDevice *out = loggers[i];
+		out->Write(Text);
+		if (out->FlushEveryTime) out->Flush();
+	}
+}
+
+
+static void WriteNotifyFile(const char *Text, int Len)
+{
+	if (!NotifyFile)
+		NotifyFile = fopen("notify.log", "a");
+	if (NotifyFile)
+		fwrite(Text, 1, Len, NotifyFile);
+}
+
+
+// pass all published records to output devices
+static void DrainLog()
+{
+	CCriticalSectionScope Lock(LogLock);
+	if (Draining) return;				// called from device's Write(), outer call will process new records
+	Draining = true;
+
+	static char Batch[LOG_BATCH_SIZE];
+	int BatchLen = 0;
+	try
+	{
+		while (LogReadPos != LogWritePos)
+		{
+			int Pos = LogReadPos;
+			volatile int *Header = &LogBuffer[(Pos & (LOG_BUFFER_SIZE - 1)) / sizeof(int)];
+			int Value;
+			// interlocked read: text should not be accessed before the header
+			while (!(Value = appInterlockedCompareExchange(Header, 0, 0)))
+				appYield();				// space is reserved, but text is not copied yet
+			int Len  = Value & ~LOG_NOTIFY;
+			int Size = GetRecordSize(Len);
+			if (BatchLen + Len >= LOG_BATCH_SIZE || (Value & LOG_NOTIFY))
+			{
+				// flush accumulated text
+				if (BatchLen)
+				{
+					Batch[BatchLen] = 0;
+					BatchLen = 0;
+					WriteDevices(Batch);
+				}
+			}
+			if (Value & LOG_NOTIFY)
+			{
+				char buf[BUFFER_LEN + 1024];
+				CopyFromRing(Pos + sizeof(int), buf, Len);
+				WriteNotifyFile(buf, Len);
+			}
+			else
+			{
+				CopyFromRing(Pos + sizeof(int), Batch + BatchLen, Len);
+				BatchLen += Len;
+			}
+			// release record space
+			ClearRing(Pos, Size);
+			appInterlockedExchange(&LogReadPos, Pos + Size);
+		}
+		if (BatchLen)
+		{
+			Batch[BatchLen] = 0;
+			WriteDevices(Batch);
+		}
+	}
+	catch (...)
+	{
+		Draining = false;
+		THROW_AGAIN;
+	}
+	Draining = false;
+}
+
+
+static void WakeLogger()
+{
+	if (!LoggerSleeping || !appInterlockedExchange(&LoggerSleeping, 0))
+		return;
+#if _WIN32
+	ReleaseSemaphore(LoggerSemaphore, 1, NULL);
+#else
+	sem_post(&LoggerSemaphore);
+#endif
+}
+
+
+static void SleepLogger()
+{
+	appInterlockedExchange(&LoggerSleeping, 1);
+	if (LogReadPos != LogWritePos || LoggerQuit)
+	{
+		// record was published meanwhile: cancel sleeping, if wakeup was not posted yet
+		if (appInterlockedExchange(&LoggerSleeping, 0))
+			return;
+	}
+#if _WIN32
+	WaitForSingleObject(LoggerSemaphore, INFINITE);
+#else
+	while (sem_wait(&LoggerSemaphore) && errno == EINTR)
+	{
+		// interrupted by signal
+	}
+#endif
+}
+
+
+static void LoggerThread()
+{
+	while (!LoggerQuit)
+	{
+		SleepLogger();
+		try
+		{
+			DrainLog();
+			// keep notify.log up to date, when there is nothing to write
+			CCriticalSectionScope Lock(LogLock);
+			if (NotifyFile && LogReadPos == LogWritePos)
+				fflush(NotifyFile);
+		}
+		catch (...)
+		{
+			// device error: there is nobody to pass it to
+			appResetError();
+		}
+	}
+}
+
+
+#if _WIN32
+static DWORD WINAPI LoggerThreadFunc(void *Param)
+{
+	LoggerThread();
+	return 0;
+}
+#else
+static void* LoggerThreadFunc(void *Param)
+{
+	LoggerThread();
+	return NULL;
+}
+#endif
+
+
+static void StopLogger()
+{
+	if (LoggerState == LOGGER_RUNNING)
+	{
+		LoggerQuit = 1;
+		appInterlockedExchange(&LoggerSleeping, 0);
+#if _WIN32
+		ReleaseSemaphore(LoggerSemaphore, 1, NULL);
+		WaitForSingleObject(LoggerThreadHandle, INFINITE);
+		CloseHandle(LoggerThreadHandle);
+#else
+		sem_post(&LoggerSemaphore);
+		pthread_join(LoggerThreadHandle, NULL);
+#endif
+	}
+	// log functions may be called from destructors of static objects
+	LoggerState = LOGGER_SYNC;
+	appFlushLog();
+}
+
+
+static void StartLogger()
+{
+	CCriticalSectionScope Lock(LogLock);
+	if (LoggerState != LOGGER_NONE) return;
+	// when thread could not be started, log will work synchronously
+	LoggerState = LOGGER_SYNC;
+#if _WIN32
+	LoggerSemaphore = CreateSemaphore(NULL, 0, 0x7FFFFFFF, NULL);
+	if (!LoggerSemaphore) return;
+	LoggerThreadHandle = CreateThread(NULL, 0, LoggerThreadFunc, NULL, 0, NULL);
+	if (!LoggerThreadHandle) return;
+#else
+	if (sem_init(&LoggerSemaphore, 0, 0)) return;
+	if (pthread_create(&LoggerThreadHandle, NULL, LoggerThreadFunc, NULL)) return;
+#endif
+	LoggerState = LOGGER_RUNNING;
+	atexit(StopLogger);
+}
+
+
+static void LogText(const char *Text, int Len, int Flags = 0)
+{
+	if (LoggerState == LOGGER_NONE)
+		StartLogger();
+	while (!PushRecord(Text, Len, Flags))
+	{
+		// buffer is full
+		if (Draining && LogLock.IsOwner())
+		{
+			// logged from device's Write() - no way to wait for space
+			if (!(Flags & LOG_NOTIFY)) WriteDevices(Text);
+			return;
+		}
+		DrainLog();
+	}
+	if (LoggerState == LOGGER_RUNNING)
+		WakeLogger();
+	else
+		DrainLog();
+}
+
+
+void appFlushLog()
+{
+	DrainLog();
+	CCriticalSectionScope Lock(LogLock);
+	for (int i = 0; i < numDevices; i++)
+		loggers[i]->Flush();
+	if (NotifyFile) fflush(NotifyFile);
+}
+
+
 void appPrintf(const char *fmt, ...)
 {
 	guard(appPrintf);
@@ -121,12 +455,7 @@ void appPrintf(const char *fmt, ...)
 	va_end(argptr);
 	if (len < 0 || len >= sizeof(buf) - 1) return;		//?? may be, write anyway
 
-	for (int i = 0; i < numDevices; i++)
-	{
-		COutputDevice *out = loggers[i];
-		out->Write(buf);
-		if (out->FlushEveryTime) out->Flush();
-	}
+	if (len) LogText(buf, len);
 	unguard;
 }
 
@@ -134,6 +463,8 @@ void appPrintf(const char *fmt, ...)
 	Simple error/notofication functions
 -----------------------------------------------------------------------------*/
 
+static void AppendGuardStack();
+
 void appError(const char *fmt, ...)
 {
 	va_list	argptr;
@@ -144,8 +475,16 @@ void appError(const char *fmt, ...)
 	if (len < 0 || len >= sizeof(buf) - 1) exit(1);
 
 //	appNotify("ERROR: %s\n", buf);
-	strcpy(GErrorHistory, buf);
+	try
+	{
+		appFlushLog();				// log may be lost, if the error is fatal
+	}
+	catch (...)
+	{}
+	appResetError();
+	appStrncpyz(GErrorHistory, buf, sizeof(GErrorHistory));
 	appStrcatn(ARRAY_ARG(GErrorHistory), "\n");
+	AppendGuardStack();
 	THROW;
 }
 
@@ -154,45 +493,52 @@ static char NotifyBuf[512];
 
 void appSetNotifyHeader(const char *fmt, ...)
 {
+	char buf[sizeof(NotifyBuf)];
 	va_list	argptr;
 	va_start(argptr, fmt);
-	int len = vsnprintf(ARRAY_ARG(NotifyBuf), fmt, argptr);
+	vsnprintf(ARRAY_ARG(buf), fmt, argptr);
 	va_end(argptr);
+	{
+		CCriticalSectionScope Lock(LogLock);
+		strcpy(NotifyBuf, buf);
+	}
 	// print to console
-	if (NotifyBuf[0])
-		appPrintf("******** %s ********\n", NotifyBuf);
+	if (buf[0])
+		appPrintf("******** %s ********\n", buf);
 }
 
 
 void appNotify(const char *fmt, ...)
 {
 	guard(appNotify);
+	// header and message are logged as a single record, so notifications from
+	// different threads are not mixed
+	char buf[BUFFER_LEN + 1024];
+	int pos = 0;
+	{
+		CCriticalSectionScope Lock(LogLock);
+		if (NotifyBuf[0])
+			pos = appSprintf(buf, 1024, "\n******** %s ********\n\n", NotifyBuf);
+		// clean notify header
+		NotifyBuf[0] = 0;
+	}
 	va_list	argptr;
 	va_start(argptr, fmt);
-	char buf[BUFFER_LEN];
-	int len = vsnprintf(ARRAY_ARG(buf), fmt, argptr);
+	int len = vsnprintf(buf + pos, BUFFER_LEN, fmt, argptr);
 	va_end(argptr);
-	if (len < 0 || len >= sizeof(buf) - 1) exit(1);
+	if (len < 0 || len >= BUFFER_LEN - 1) exit(1);
 
 	// print to log file
-	if (FILE *f = fopen("notify.log", "a"))
-	{
-		// print header
-		if (NotifyBuf[0])
-			fprintf(f, "\n******** %s ********\n\n", NotifyBuf);
-		// print message
-		fprintf(f, "%s\n", buf);
-		fclose(f);
-	}
-	appPrintf("*** %s\n", buf);
-	// clean notify header
-	NotifyBuf[0] = 0;
+	buf[pos + len] = '\n';
+	LogText(buf, pos + len + 1, LOG_NOTIFY);
+	buf[pos + len] = 0;
+	appPrintf("*** %s\n", buf + pos);
 	unguard;
 }
 
 
-char GErrorHistory[2048];
-static bool WasError = false;
+THREAD_LOCAL char GErrorHistory[2048];
+static THREAD_LOCAL bool WasError = false;
 
 static void LogHistory(const char *part)
 {
@@ -231,6 +577,57 @@ void appUnwindThrow(const char *fmt, ...)
 }
 
 
+void appResetError()
+{
+	GErrorHistory[0] = 0;
+	WasError = false;
+}
+
+
+void appRethrowError(const char *History, bool OtherThread)
+{
+	appStrncpyz(GErrorHistory, History, sizeof(GErrorHistory));
+	// history ends with "\n" when error was not unwound by guard/unguard yet
+	int len = strlen(GErrorHistory);
+	WasError = len && GErrorHistory[len-1] != '\n';
+	if (OtherThread)
+		AppendGuardStack();
+	THROW;
+}
+
+
+#if DO_GUARD_SHADOW
+
+THREAD_LOCAL CGuardStack GGuardStack;
+
+// build call history from the shadow stack, innermost function first
+static void AppendGuardStack()
+{
+	int Depth = GGuardStack.Depth;
+	if (Depth > MAX_GUARD_DEPTH)
+	{
+		LogHistory(WasError ? " <- ..." : "...");
+		WasError = true;
+		Depth = MAX_GUARD_DEPTH;
+	}
+	for (int i = Depth - 1; i >= GGuardStack.Base; i--)
+	{
+		if (WasError) LogHistory(" <- ");
+		LogHistory(GGuardStack.Frames[i]);
+		WasError = true;
+	}
+}
+
+#else
+
+static void AppendGuardStack()
+{
+	// history is collected by unguard while unwinding
+}
+
+#endif // DO_GUARD_SHADOW
+
+
 /*-----------------------------------------------------------------------------
 	CArchive helpers
 -----------------------------------------------------------------------------*/
@@ -244,10 +641,49 @@ void CArchive::ByteOrderSerialize(void *data, int size)
 #endif
 
 
+// maximal size of serialized CCompactIndex: 6 bits in the 1st byte and 7 bits in
+// each following byte
+#define MAX_COMPACT_INDEX_SIZE		5
+
 CArchive& operator<<(CArchive &Ar, CCompactIndex &I)
 {
 	if (Ar.IsLoading)
 	{
+		if (Ar.BufEnd - Ar.BufPtr >= MAX_COMPACT_INDEX_SIZE)
+		{
+			// fast path: decode directly from archive buffer
+			const byte *p = Ar.BufPtr;
+			unsigned b = *p++;
+			int r = b & 0x3F;
+			if (b & 0x40)			// has 2nd byte
+			{
+				unsigned c = *p++;
+				r |= (c & 0x7F) << 6;
+				if (c & 0x80)
+				{
+					c = *p++;
+					r |= (c & 0x7F) << 13;
+					if (c & 0x80)
+					{
+						c = *p++;
+						r |= (c & 0x7F) << 20;
+						if (c & 0x80)
+						{
+							c = *p++;
+							r |= c << 27;
+							if (c & 0x80)
+								appError("Invalid compact index at %d", Ar.ArPos);
+						}
+					}
+				}
+			}
+			// apply sign without branching
+			int sign = -(int)(b >> 7);
+			I.Value  = (r ^ sign) - sign;
+			Ar.ArPos += p - Ar.BufPtr;
+			Ar.BufPtr = (byte*)p;
+			return Ar;
+		}
 		byte b;
 		Ar << b;
 		int sign  = b & 0x80;	// sign bit
@@ -266,6 +702,9 @@ CArchive& operator<<(CArchive &Ar, CCompactIndex &I)
 	}
 	else
 	{
+		// encode into temporary buffer, then write with a single call
+		byte buf[MAX_COMPACT_INDEX_SIZE];
+		byte *p = buf;
 		int v = I.Value;
 		byte b = 0;
 		if (v < 0)
@@ -276,13 +715,13 @@ CArchive& operator<<(CArchive &Ar, CCompactIndex &I)
 		b |= v & 0x3F;
 		if (v <= 0x3F)
 		{
-			Ar << b;
+			*p++ = b;
 		}
 		else
 		{
 			b |= 0x40;			// has 2nd byte
 			v >>= 6;
-			Ar << b;
+			*p++ = b;
 			assert(v);
 			while (v)
 			{
@@ -290,9 +729,10 @@ CArchive& operator<<(CArchive &Ar, CCompactIndex &I)
 				v >>= 7;
 				if (v)
 					b |= 0x80;	// has more bytes
-				Ar << b;
+				*p++ = b;
 			}
 		}
+		Ar.Serialize(buf, p - buf);
 	}
 	return Ar;
 }
@@ -322,11 +762,80 @@ void* LoadFile(const char* filename)
 }
 
 
+static unsigned CrcTable[256];
+
+// table is filled during static initialization, so appCrc32() is thread-safe
+static struct CCrcTableInit
+{
+	CCrcTableInit()
+	{
+		for (unsigned i = 0; i < 256; i++)
+		{
+			unsigned c = i;
+			for (int k = 0; k < 8; k++)
+				c = (c & 1) ? (c >> 1) ^ 0xEDB88320 : c >> 1;
+			CrcTable[i] = c;
+		}
+	}
+} CrcTableInit;
+
+unsigned appCrc32(const void *Data, int Size, unsigned Crc)
+{
+	const byte *p = (const byte*)Data;
+	Crc = ~Crc;
+	while (Size-- > 0)
+		Crc = CrcTable[(Crc ^ *p++) & 0xFF] ^ (Crc >> 8);
+	return ~Crc;
+}
+
+
+#define HASH_MUL		0x9E3779B97F4A7C15ull		// 2^64 / golden ratio
+
+static FORCEINLINE qword HashMix(qword Hash, qword Value)
+{
+	Hash = (Hash ^ Value) * HASH_MUL;
+	return Hash ^ (Hash >> 29);
+}
+
+qword appHash64(const void *Data, int Size, qword Hash)
+{
+	const byte *p = (const byte*)Data;
+	Hash = HashMix(Hash, Size);
+	// process data in 8-byte words
+	for ( ; Size >= 8; Size -= 8, p += 8)
+	{
+		qword w;
+#if LITTLE_ENDIAN
+		memcpy(&w, p, 8);
+#else
+		w = 0;
+		for (int i = 7; i >= 0; i--)
+			w = (w << 8) | p[i];
+#endif
+		Hash = HashMix(Hash, w);
+	}
+	// tail
+	qword w = 0;
+	for (int i = 0; i < Size; i++)
+		w |= (qword)p[i] << (i * 8);
+	return HashMix(Hash, w);
+}
+
+
+unsigned appStrHash(const char *Str)
+{
+	unsigned Hash = 2166136261u;
+	while (byte c = *Str++)
+		Hash = (Hash ^ c) * 16777619u;
+	return Hash;
+}
+
+
 /*-----------------------------------------------------------------------------
 	CArray implementation
 -----------------------------------------------------------------------------*/
 
-void CArray::Empty(int count, int elementSize)
+void CArray::Empty(int count, int elementSize, int alignment)
 {
 	if (DataPtr)
 		appFree(DataPtr);
@@ -335,58 +844,82 @@ void CArray::Empty(int count, int elementSize)
 	MaxCount  = count;
 	if (count)
 	{
-		DataPtr = appMalloc(count * elementSize);
-		memset(DataPtr, 0, count * elementSize);
+		DataPtr = appMallocNoInit(count * elementSize, alignment);
 	}
 }
 
 
-void CArray::Insert(int index, int count, int elementSize)
+void CArray::Reserve(int count, int elementSize, int alignment, RelocateFunc Relocate)
 {
-	guard(CArray::Insert);
+	guard(CArray::Reserve);
+	if (count <= MaxCount) return;
+	MaxCount = count;
+	if (!Relocate)
+	{
+		DataPtr = appRealloc(DataPtr, MaxCount * elementSize, alignment);
+		return;
+	}
+	// items could not be moved by realloc()
+	void *NewData = appMallocNoInit(MaxCount * elementSize, alignment);
+	if (DataCount)
+		Relocate(NewData, DataPtr, DataCount);
+	if (DataPtr)
+		appFree(DataPtr);
+	DataPtr = NewData;
+	unguard;
+}
+
+
+void CArray::Insert(int index, int count, int elementSize, int alignment, bool zero, RelocateFunc Relocate)
+{
+	guardSlow(CArray::Insert);
 	if (count <= 0) return;
 	assert(index >= 0);
 	assert(index <= DataCount);
 	// check for available space
 	if (DataCount + count > MaxCount)
 	{
-		// not enough space, resize ...
-		int prevCount = MaxCount;
-		MaxCount = ((DataCount + count + 7) / 8) * 8 + 8;
-		DataPtr = appRealloc(DataPtr, MaxCount * elementSize);
-		// zero added memory
-		memset(
-			(byte*)DataPtr + prevCount * elementSize,
-			0,
-			(MaxCount - prevCount) * elementSize
-		);
+		// not enough space, grow by 1.5 times, so sequence of Add() calls
+		// has linear complexity
+		Reserve(max(DataCount + count, MaxCount + MaxCount / 2 + 16), elementSize, alignment, Relocate);
 	}
 	// move data
-	memmove(
-		(byte*)DataPtr + (index + count)     * elementSize,
-		(byte*)DataPtr + index               * elementSize,
-						 (DataCount - index) * elementSize
-	);
+	byte *Src = (byte*)DataPtr + index * elementSize;
+	int tail = DataCount - index;
+	if (tail)
+	{
+		if (Relocate)
+			Relocate(Src + count * elementSize, Src, tail);
+		else
+			memmove(Src + count * elementSize, Src, tail * elementSize);
+	}
+	if (zero)
+		memset(Src, 0, count * elementSize);
 	// last operation: advance counter
 	DataCount += count;
-	unguard;
+	unguardSlow;
 }
 
-void CArray::Remove(int index, int count, int elementSize)
+
+void CArray::Remove(int index, int count, int elementSize, RelocateFunc Relocate)
 {
-	guard(CArray::Remove);
+	guardSlow(CArray::Remove);
 	if (count <= 0) return;
 	assert(index >= 0);
 	assert(index + count <= DataCount);
 	// move data
-	memcpy(
-		(byte*)DataPtr + index                       * elementSize,
-		(byte*)DataPtr + (index + count)             * elementSize,
-						 (DataCount - index - count) * elementSize
-	);
+	byte *Dst = (byte*)DataPtr + index * elementSize;
+	int tail = DataCount - index - count;
+	if (tail)
+	{
+		if (Relocate)
+			Relocate(Dst, Dst + count * elementSize, tail);
+		else
+			memmove(Dst, Dst + count * elementSize, tail * elementSize);
+	}
 	// decrease counter
 	DataCount -= count;
-	unguard;
+	unguardSlow;
 }
 
 
@@ -6,6 +6,7 @@
 #include <stdarg.h>
 #include <string.h>
 #include <math.h>
+#include <new>					// placement new
 
 
 // undefine some windows defines
@@ -19,20 +20,27 @@
 class CArchive;
 class CMemoryChain;
 class CObject;
+class CSerializeContext;
 
 
 /*-----------------------------------------------------------------------------
 	Some macros
 -----------------------------------------------------------------------------*/
 
+// align integer or pointer; alignment should be a power of 2
 template<class T> inline T Align(const T ptr, int alignment)
 {
-	return (T) (((unsigned)ptr + alignment - 1) & ~(alignment - 1));
+	return (T) (((size_t)ptr + alignment - 1) & ~(size_t)(alignment - 1));
+}
+
+template<class T> inline bool IsAligned(const T ptr, int alignment)
+{
+	return ((size_t)ptr & (alignment - 1)) == 0;
 }
 
 template<class T> inline T OffsetPointer(const T ptr, int offset)
 {
-	return (T) ((unsigned)ptr + offset);
+	return (T) ((size_t)ptr + offset);
 }
 
 template<class T> inline void Exchange(T& A, T& B)
@@ -52,7 +60,7 @@ template<class T> inline void QSort(T* array, int count, int (*cmpFunc)(const T*
 #ifdef offsetof
 #	define FIELD2OFS(struc, field)		(offsetof(struc, field))				// more compatible
 #else
-#	define FIELD2OFS(struc, field)		((unsigned) &((struc *)NULL)->field)	// just in case
+#	define FIELD2OFS(struc, field)		((size_t) &((struc *)NULL)->field)		// just in case
 #endif
 // get field of type by offset inside struc
 #define OFS2FIELD(struc, ofs, type)	(*(type*) ((byte*)(struc) + ofs))
@@ -133,6 +141,7 @@ template<class T> inline void QSort(T* array, int count, int (*cmpFunc)(const T*
 #	define vsnprintf		_vsnprintf
 #	define FORCEINLINE		__forceinline
 #	define NORETURN			__declspec(noreturn)
+#	define ALIGNOF(type)	__alignof(type)
 #	define stricmp				_stricmp
 #	define strnicmp				_strnicmp
 	// disable some warnings
@@ -152,6 +161,7 @@ template<class T> inline void QSort(T* array, int count, int (*cmpFunc)(const T*
 #elif __GNUC__
 
 #	define NORETURN				__attribute__((noreturn))
+#	define ALIGNOF(type)		__alignof__(type)
 #	if (__GNUC__ > 3) || ((__GNUC__ == 3) && (__GNUC_MINOR__ >= 2))
 	// strange, but there is only way to work (inline+always_inline)
 #		define FORCEINLINE		inline __attribute__((always_inline))
@@ -174,6 +184,11 @@ template<class T> inline void QSort(T* array, int count, int (*cmpFunc)(const T*
 // necessary types
 typedef unsigned char		byte;
 typedef unsigned short		word;
+#if _MSC_VER
+typedef unsigned __int64	qword;
+#else
+typedef unsigned long long	qword;
+#endif
 
 
 #define COLOR_ESCAPE	'^'		// may be used for quick location of color-processing code
@@ -188,7 +203,11 @@ typedef unsigned short		word;
 #define S_WHITE			"^7"
 
 
+// appPrintf() and appNotify() are asynchronous: text is passed to output devices
+// and notify.log by a background thread. appFlushLog() writes all text, logged
+// before the call, and flushes devices; it is called by appError() and at exit.
 void appPrintf(const char *fmt, ...);
+void appFlushLog();
 void appError(const char *fmt, ...);
 
 // log some interesting information
@@ -197,6 +216,14 @@ void appNotify(const char *fmt, ...);
 
 void* LoadFile(const char* filename);
 
+// CRC-32 (IEEE 802.3 polynomial); pass previous result as 'Crc' to continue computation
+unsigned appCrc32(const void *Data, int Size, unsigned Crc = 0);
+// Fast 64-bit hash for change detection (not for error detection); may be computed
+// block by block, passing previous result as 'Hash'
+qword appHash64(const void *Data, int Size, qword Hash = 0);
+// Hash of null-terminated string (FNV-1a), for name lookup tables
+unsigned appStrHash(const char *Str);
+
 void appInit();
 
 
@@ -228,24 +255,46 @@ extern COutputDevice	*GNull;			// do not output
 	Memory management
 -----------------------------------------------------------------------------*/
 
-void* appMalloc(int size);
-void* appRealloc(void *ptr, int size);
+// alignment of all appMalloc() blocks; vectorized code may use aligned SSE loads
+#define MALLOC_ALIGNMENT	16
+#define CACHE_LINE_SIZE		64
+
+// appMalloc() returns zero-filled memory, appMallocNoInit() - uninitialized one;
+// appRealloc() does not initialize added memory. 'alignment' is a power of 2, up
+// to 4096; appRealloc() should be called with the same alignment, as the block
+// was allocated with. Blocks of any alignment are released with appFree().
+void* appMalloc(int size, int alignment = MALLOC_ALIGNMENT);
+void* appMallocNoInit(int size, int alignment = MALLOC_ALIGNMENT);
+void* appRealloc(void *ptr, int size, int alignment = MALLOC_ALIGNMENT);
 void  appFree(void *ptr);
-
-FORCEINLINE void* operator new(size_t size)
-{
-	return appMalloc(size);
-}
-
-FORCEINLINE void* operator new[](size_t size)
-{
-	return appMalloc(size);
-}
-
-FORCEINLINE void operator delete(void* ptr)
-{
-	appFree(ptr);
-}
+// should be called by a thread before exit: returns blocks, cached by this thread,
+// to the shared pool, and frees thread's scratch memory
+void  appReleaseThreadCache();
+
+// Global operator new/delete are replaced in Memory.cpp (not inline: objects may be
+// released by other modules, e.g. wxWidgets, and vice versa). Memory of 'new' is
+// zero-filled. RETAIL build (runtime library) does not replace global operators,
+// the game may use its own allocator: classes, which are allocated by our code,
+// are using DECLARE_ALLOCATOR instead.
+
+// class-scope operator new/delete, using appMalloc(); memory is zero-filled
+#define DECLARE_ALLOCATOR							\
+	FORCEINLINE void* operator new(size_t size)		\
+	{												\
+		return appMalloc((int)size);				\
+	}												\
+	FORCEINLINE void* operator new[](size_t size)	\
+	{												\
+		return appMalloc((int)size);				\
+	}												\
+	FORCEINLINE void operator delete(void *ptr)		\
+	{												\
+		appFree(ptr);								\
+	}												\
+	FORCEINLINE void operator delete[](void *ptr)	\
+	{												\
+		appFree(ptr);								\
+	}
 
 #define DEFAULT_ALIGNMENT	8
 #define MEM_CHUNK_SIZE		0x2000		// 8Kb
@@ -280,6 +329,253 @@ FORCEINLINE void* operator new[](size_t size, CMemoryChain *chain, int alignment
 }
 
 
+/**
+ * Scratch memory: thread-local linear arena for temporary buffers. Allocation
+ * moves a pointer, memory is not initialized. appScratchRewind() releases all
+ * allocations, made after the mark was taken; CScratchScope does this at the
+ * end of the scope. Released chunks are kept for reuse by the same thread.
+ */
+struct CScratchMark
+{
+	void	*Chunk;
+	byte	*Top;
+};
+
+void* appScratchAlloc(int size, int alignment = DEFAULT_ALIGNMENT);
+CScratchMark appScratchMark();
+void  appScratchRewind(const CScratchMark &Mark);
+
+class CScratchScope
+{
+private:
+	CScratchMark	Mark;
+public:
+	CScratchScope()
+	:	Mark(appScratchMark())
+	{}
+	~CScratchScope()
+	{
+		appScratchRewind(Mark);
+	}
+};
+
+template<class T> FORCEINLINE T* NewScratch(int count, int alignment = DEFAULT_ALIGNMENT)
+{
+	return (T*)appScratchAlloc(count * sizeof(T), alignment);
+}
+
+
+/*-----------------------------------------------------------------------------
+	Multithreading
+-----------------------------------------------------------------------------*/
+
+#if _MSC_VER
+extern "C" long __cdecl _InterlockedExchangeAdd(long volatile *Addend, long Value);
+extern "C" long __cdecl _InterlockedExchange(long volatile *Target, long Value);
+extern "C" long __cdecl _InterlockedCompareExchange(long volatile *Target, long Value, long Comparand);
+#pragma intrinsic(_InterlockedExchangeAdd)
+#pragma intrinsic(_InterlockedExchange)
+#pragma intrinsic(_InterlockedCompareExchange)
+#define THREAD_LOCAL		__declspec(thread)
+#else
+#define THREAD_LOCAL		__thread
+#endif
+
+// atomically add Value to *Addend, returns previous value
+FORCEINLINE int appInterlockedAdd(volatile int *Addend, int Value)
+{
+#if _MSC_VER
+	return _InterlockedExchangeAdd((volatile long*)Addend, Value);
+#else
+	return __sync_fetch_and_add(Addend, Value);
+#endif
+}
+
+// atomically set *Target to Value, returns previous value
+FORCEINLINE int appInterlockedExchange(volatile int *Target, int Value)
+{
+#if _MSC_VER
+	return _InterlockedExchange((volatile long*)Target, Value);
+#else
+	__sync_synchronize();
+	return __sync_lock_test_and_set(Target, Value);
+#endif
+}
+
+// atomically set *Target to Value when it is equal to Comparand, returns previous value
+FORCEINLINE int appInterlockedCompareExchange(volatile int *Target, int Value, int Comparand)
+{
+#if _MSC_VER
+	return _InterlockedCompareExchange((volatile long*)Target, Value, Comparand);
+#else
+	return __sync_val_compare_and_swap(Target, Comparand, Value);
+#endif
+}
+
+int appGetNumCores();
+// small unique number of the current thread, never 0
+int appGetThreadId();
+// give the rest of time slice to other threads
+void appYield();
+
+
+// Recursive lock for rarely contended data (log devices etc). Waiting thread spins
+// and yields, so the lock should not be held for a long time.
+class CCriticalSection
+{
+public:
+	CCriticalSection()
+	:	Lock(0)
+	,	Owner(0)
+	,	Depth(0)
+	{}
+	void Enter();
+	void Leave();
+	// true when locked by the current thread
+	bool IsOwner() const
+	{
+		return Owner == appGetThreadId();
+	}
+
+private:
+	volatile int	Lock;
+	int				Owner;
+	int				Depth;
+};
+
+class CCriticalSectionScope
+{
+private:
+	CCriticalSection &Section;
+public:
+	CCriticalSectionScope(CCriticalSection &S)
+	:	Section(S)
+	{
+		Section.Enter();
+	}
+	~CCriticalSectionScope()
+	{
+		Section.Leave();
+	}
+};
+
+
+/**
+ * Job system. Jobs are executed by a pool of worker threads, which is created on
+ * the first use (one worker per CPU core, except the calling thread). Every worker
+ * has its own job queue; idle workers steal jobs from queues of other threads.
+ * Thread, which waits for jobs, executes queued jobs too, so a job may start other
+ * jobs and wait for them without a deadlock.
+ */
+
+typedef void (*JobFunc)(void *Param);
+
+// Counter of unfinished jobs. Should live until all its jobs are finished; the
+// destructor waits for them and drops the error, if any.
+class CJobCounter
+{
+public:
+	// used by the job system only
+	volatile int	Count;
+	volatile int	Lock;
+	struct CJob		*Waiting;			// jobs, which depend on this counter
+	char			*Error;				// error history of the first failed job
+
+	CJobCounter()
+	:	Count(0)
+	,	Lock(0)
+	,	Waiting(NULL)
+	,	Error(NULL)
+	{}
+	~CJobCounter();
+
+	bool IsDone() const
+	{
+		return Count == 0;
+	}
+};
+
+// Queue Func(Param) for execution. When Counter is not NULL, it is incremented,
+// and decremented after the job is finished. When Dependency is not NULL, the job
+// is not started until all jobs of Dependency are finished; when one of them has
+// failed, the job is not executed, and its Counter receives the same error. Error
+// of a job without counter is passed to appNotify().
+void appRunJob(JobFunc Func, void *Param, CJobCounter *Counter = NULL, CJobCounter *Dependency = NULL);
+// Wait for all jobs of Counter, executing queued jobs meanwhile. Error of a failed
+// job is rethrown in the calling thread.
+void appWaitJobs(CJobCounter &Counter);
+// number of threads, which execute jobs: workers and the calling thread
+int appGetNumJobThreads();
+
+typedef void (*ParallelFunc)(int Index, void *Param);
+
+// Call Func(Index, Param) for Index = [0..Count-1] using up to MaxThreads threads (0 means
+// all job threads). Indices are processed in chunks of Grain items (0 means automatic
+// choice; use larger values for cheap calls). Order of calls is not defined. Error in any
+// call is rethrown in the caller thread, after all started calls are finished.
+void appParallelFor(int Count, ParallelFunc Func, void *Param, int MaxThreads = 0, int Grain = 0);
+
+
+/*-----------------------------------------------------------------------------
+	Allocation statistics
+-----------------------------------------------------------------------------*/
+
+// When MEM_STATS is enabled, every block of appMalloc() has a small header with
+// its size, tag and call site, and per-tag counters are updated on every allocation;
+// blocks, which are still allocated at exit, are listed in memory.log. When
+// disabled, MEM_TAG() expands to nothing and allocation functions are not changed.
+#ifndef MEM_STATS
+#define MEM_STATS			0
+#endif
+
+// allocation tags
+enum EMemTag
+{
+	MEM_Default,
+	MEM_Mesh,
+	MEM_Anim,
+	MEM_Typeinfo,
+	MEM_GL,
+	MEM_Editor,
+
+	MEM_NUM_TAGS
+};
+
+#if MEM_STATS
+
+extern THREAD_LOCAL int GMemTag;		// tag of allocations, made by current thread
+
+class CMemTagScope
+{
+private:
+	int		PrevTag;
+public:
+	CMemTagScope(int Tag)
+	:	PrevTag(GMemTag)
+	{
+		GMemTag = Tag;
+	}
+	~CMemTagScope()
+	{
+		GMemTag = PrevTag;
+	}
+};
+
+// attribute allocations until the end of current scope to Tag
+#define MEM_TAG(Tag)		CMemTagScope _MemTag(Tag)
+
+#else
+
+#define MEM_TAG(Tag)
+
+#endif // MEM_STATS
+
+// print live and peak bytes and block counts for every tag
+void appDumpMemoryStats(COutputDevice *Out = GLog);
+// number of allocations since previous call; always 0 when MEM_STATS is disabled
+int  appMemoryFrame();
+
+
 /*-----------------------------------------------------------------------------
 	Crash helpers
 -----------------------------------------------------------------------------*/
@@ -288,23 +584,40 @@ FORCEINLINE void* operator new[](size_t size, CMemoryChain *chain, int alignment
 // will generate static string and static pointer variable, but in the 1st case - only
 // static string.
 
+// Guard modes:
+//	DO_GUARD_SHADOW=0	C++exception-based guard/unguard system: every guarded block
+//						is a try/catch, call history is collected while unwinding
+//	DO_GUARD_SHADOW=1	guard pushes function name to thread-local shadow stack and
+//						unguard pops it; history is built from the shadow stack by
+//						appError(), so there are no try blocks in guarded functions.
+//						unguardf(msg) works as unguard, message is not logged.
+// guardSlow/unguardSlow are used for functions, called in inner loops: they are compiled
+// out unless DO_GUARD_SLOW is set.
+#ifndef DO_GUARD_SHADOW
+#define DO_GUARD_SHADOW		0
+#endif
+#ifndef DO_GUARD_SLOW
+#define DO_GUARD_SLOW		0
+#endif
+
+#if DO_GUARD_MAX
+#define GUARD_FUNC_NAME		__FUNCSIG__
+#else
+#define GUARD_FUNC_NAME		__FUNCTION__
+#endif
+
+#if !DO_GUARD_SHADOW
+
 // C++exception-based guard/unguard system
 #define guard(func)						\
 	{									\
 		static const char *__FUNC__ = #func; \
 		try {
 
-#if DO_GUARD_MAX
-#define guardfunc						\
-	{									\
-		static const char *__FUNC__ = __FUNCSIG__; \
-		try {
-#else
 #define guardfunc						\
 	{									\
-		static const char *__FUNC__ = __FUNCTION__; \
+		static const char *__FUNC__ = GUARD_FUNC_NAME; \
 		try {
-#endif
 
 #define unguard							\
 		} catch (...) {					\
@@ -320,9 +633,61 @@ FORCEINLINE void* operator new[](size_t size, CMemoryChain *chain, int alignment
 		}								\
 	}
 
+#else // DO_GUARD_SHADOW
+
+#define MAX_GUARD_DEPTH		256
+
+struct CGuardStack
+{
+	const char	*Frames[MAX_GUARD_DEPTH];
+	int			Depth;				// may be larger than MAX_GUARD_DEPTH, deeper frames are not stored
+	int			Base;				// frames below Base are not logged (used by job system)
+};
+
+extern THREAD_LOCAL CGuardStack GGuardStack;
+
+class CGuardFrame
+{
+public:
+	FORCEINLINE CGuardFrame(const char *Name)
+	{
+		int Depth = GGuardStack.Depth++;
+		if (Depth < MAX_GUARD_DEPTH)
+			GGuardStack.Frames[Depth] = Name;
+	}
+	FORCEINLINE ~CGuardFrame()
+	{
+		GGuardStack.Depth--;
+	}
+};
+
+#define guard(func)						\
+	{									\
+		CGuardFrame _GuardFrame(#func);	\
+		{
+
+#define guardfunc						\
+	{									\
+		CGuardFrame _GuardFrame(GUARD_FUNC_NAME); \
+		{
+
+#define unguard							\
+		}								\
+	}
+
+#define unguardf(msg)	unguard
+
+#endif // DO_GUARD_SHADOW
+
+#if DO_GUARD_SLOW
 #define guardSlow		guard
 #define unguardSlow		unguard
 #define unguardfSlow	unguardf
+#else
+#define guardSlow(func)	{
+#define unguardSlow		}
+#define unguardfSlow(msg) }
+#endif
 
 #define TRY				try
 #define CATCH			catch (...)
@@ -335,7 +700,14 @@ FORCEINLINE void* operator new[](size_t size, CMemoryChain *chain, int alignment
 void appUnwindPrefix(const char *fmt);		// not vararg (will display function name for unguardf only)
 NORETURN void appUnwindThrow(const char *fmt, ...);
 
-extern char GErrorHistory[2048];
+// Error history and unwinding state are kept per thread. These functions are used
+// to pass an error, caught in one thread, to another one. When a saved error is
+// rethrown in the same thread, OtherThread should be false: with shadow stack guards
+// the history already has the calling functions.
+void appResetError();
+NORETURN void appRethrowError(const char *History, bool OtherThread = true);
+
+extern THREAD_LOCAL char GErrorHistory[2048];
 
 
 /*-----------------------------------------------------------------------------
@@ -360,16 +732,25 @@ public:
 
 class CArchive
 {
+	friend CArchive& operator<<(CArchive &Ar, CCompactIndex &I);
 public:
+	DECLARE_ALLOCATOR
+
 	bool	IsLoading;
 	int		ArVer;
 	int		ArPos;
-	int		ArStopper;
+	int		ArStopper;			// should be changed with SetStopper()
+	CSerializeContext *ObjContext;	// object links, valid inside SerializeObject()
+	bool	IsUnpacked;			// data was decompressed, ArPos is not a file position
 
 	CArchive()
 	:	ArStopper(0)
 	,	ArVer(9999)			//?? something large
 	,	ArPos(0)
+	,	ObjContext(NULL)
+	,	IsUnpacked(false)
+	,	BufPtr(NULL)
+	,	BufEnd(NULL)
 	{}
 
 	virtual ~CArchive()
@@ -377,7 +758,41 @@ public:
 
 	virtual void Seek(int Pos) = 0;
 	virtual bool IsEof() = 0;
-	virtual void Serialize(void *data, int size) = 0;
+	/**
+	 * Position after the last byte of loaded archive, i.e. size of file for file
+	 * archives. Returns -1 when not known (saving archives).
+	 */
+	virtual int GetEndPos()
+	{
+		return -1;
+	}
+	/**
+	 * Serialize data. Requests, which fits archive buffer, are processed inline, all
+	 * other requests are passed to SerializeSlow().
+	 */
+	FORCEINLINE void Serialize(void *data, int size)
+	{
+		if (size <= BufEnd - BufPtr)
+		{
+			if (IsLoading)
+				memcpy(data, BufPtr, size);
+			else
+				memcpy(BufPtr, data, size);
+			BufPtr += size;
+			ArPos  += size;
+		}
+		else
+			SerializeSlow(data, size);
+	}
+	/**
+	 * Zero-copy access to 'size' bytes at current position. Returns NULL when archive
+	 * does not support this; otherwise position is advanced, and returned data remains
+	 * valid while archive is open.
+	 */
+	virtual const void* View(size_t size)
+	{
+		return NULL;
+	}
 #if LITTLE_ENDIAN
 	FORCEINLINE void ByteOrderSerialize(void *data, int size)
 	{
@@ -397,6 +812,12 @@ public:
 		return ArStopper == ArPos;
 	}
 
+	void SetStopper(int Pos)
+	{
+		ArStopper = Pos;
+		Seek(ArPos);					// let archive to recompute buffer bounds
+	}
+
 	friend CArchive& operator<<(CArchive &Ar, bool &B)
 	{
 		Ar.Serialize(&B, 1);
@@ -437,10 +858,89 @@ public:
 		Ar.ByteOrderSerialize(&B, 4);
 		return Ar;
 	}
+	friend CArchive& operator<<(CArchive &Ar, qword &B)
+	{
+		Ar.ByteOrderSerialize(&B, 8);
+		return Ar;
+	}
 	friend CArchive& operator<<(CArchive &Ar, CObject *&Obj);
+
+protected:
+	/*
+	 * Buffered serialization support. Derived class points BufPtr to a memory
+	 * block, which corresponds to the current archive position (ArPos), and
+	 * BufEnd to the end of data available for reading (or of space available
+	 * for writing). Empty buffer (BufPtr == BufEnd) passes everything to
+	 * SerializeSlow(), which should refill or flush the buffer.
+	 */
+	byte	*BufPtr;
+	byte	*BufEnd;
+
+	// setup buffer for current ArPos; buffer is limited by ArStopper
+	void SetupBuffer(byte *Start, byte *End)
+	{
+		if (ArStopper > 0 && End - Start > ArStopper - ArPos)
+			End = Start + max(ArStopper - ArPos, 0);
+		BufPtr = Start;
+		BufEnd = End;
+	}
+
+	virtual void SerializeSlow(void *data, int size) = 0;
 };
 
 
+/*-----------------------------------------------------------------------------
+	Type traits
+-----------------------------------------------------------------------------*/
+
+/*
+ * TTypeInfo<T>::IsPod is set for types, which have identical layout in memory
+ * and in archive; arrays of such types are serialized with a single Serialize()
+ * call instead of per-item operator<<. Multi-byte types are registered with
+ * RAW_TYPE() and are treated as POD on little-endian platforms only; BYTE_TYPE()
+ * is used for types, which does not depend on byte order.
+ * Type should have no padding, and its operator<< should serialize all fields
+ * in declaration order.
+ * TTypeInfo<T>::IsRelocatable is set for types, which may be moved in memory with
+ * memmove()/realloc(); TArray moves other types with copy constructor and destructor.
+ * All types are relocatable unless registered with NONRELOCATABLE_TYPE() (for example,
+ * types with pointers to own fields).
+ */
+
+template<class T> struct TTypeInfo
+{
+	enum { IsPod = 0, IsRelocatable = 1 };
+};
+
+#define BYTE_TYPE(Type)					\
+template<> struct TTypeInfo<Type>		\
+{										\
+	enum { IsPod = 1, IsRelocatable = 1 }; \
+};
+
+#define NONRELOCATABLE_TYPE(Type)		\
+template<> struct TTypeInfo<Type>		\
+{										\
+	enum { IsPod = 0, IsRelocatable = 0 }; \
+};
+
+#if LITTLE_ENDIAN
+#define RAW_TYPE(Type)		BYTE_TYPE(Type)
+#else
+#define RAW_TYPE(Type)
+#endif
+
+BYTE_TYPE(bool)
+BYTE_TYPE(char)
+BYTE_TYPE(byte)
+RAW_TYPE(short)
+RAW_TYPE(word)
+RAW_TYPE(int)
+RAW_TYPE(unsigned)
+RAW_TYPE(float)
+RAW_TYPE(qword)
+
+
 /*-----------------------------------------------------------------------------
 	TArray template
 -----------------------------------------------------------------------------*/
@@ -479,29 +979,52 @@ public:
 		return DataCount;
 	}
 
-	void Empty(int count, int elementSize);
+	// free data and allocate space for 'count' items; allocated memory is not
+	// initialized, Insert() will zero added items
+	void Empty(int count, int elementSize, int alignment = MALLOC_ALIGNMENT);
 
 protected:
 	void	*DataPtr;
 	int		DataCount;
 	int		MaxCount;
 
-	void Insert(int index, int count, int elementSize);
-	void Remove(int index, int count, int elementSize);
+	// moves 'Count' items from Src to Dst, memory ranges may overlap; used for
+	// items, which could not be moved with memmove()
+	typedef void (*RelocateFunc)(void *Dst, void *Src, int Count);
+
+	// 'alignment' should be the same for all calls on the same array
+	void Reserve(int count, int elementSize, int alignment = MALLOC_ALIGNMENT, RelocateFunc Relocate = NULL);
+	void Insert(int index, int count, int elementSize, int alignment = MALLOC_ALIGNMENT, bool zero = true, RelocateFunc Relocate = NULL);
+	void Remove(int index, int count, int elementSize, RelocateFunc Relocate = NULL);
 };
 
-// NOTE: this container cannot hold objects, required constructor/destructor
-// (at least, Add/Insert/Remove functions are not supported, but can serialize
-// such data)
-template<class T> class TArray : public CArray
+// NOTE: added items are zero-filled, and not constructed, so item types should
+// treat zero-filled memory as a valid default state (as TArray does)
+// 'Alignment' may be used to align data for SIMD code (16, 32 or 64 bytes); data
+// is always aligned to MALLOC_ALIGNMENT and to item's own alignment. Arrays with
+// custom alignment should not be used as typeinfo properties: CStruct and
+// property editor reallocate such arrays with default alignment.
+template<class T, int Alignment = 0> class TArray : public CArray
 {
 public:
+	TArray()
+	{}
+	TArray(const TArray &Other)
+	{
+		CopyItems(Other);
+	}
 	~TArray()
 	{
-		// destruct all array items
-		T *P, *P2;
-		for (P = (T*)DataPtr, P2 = P + DataCount; P < P2; P++)
-			P->~T();
+		DestructItems(0, DataCount);
+	}
+	TArray& operator=(const TArray &Other)
+	{
+		if (this != &Other)
+		{
+			Empty(Other.DataCount);
+			CopyItems(Other);
+		}
+		return *this;
 	}
 	// data accessors
 	T& operator[](int index)
@@ -515,26 +1038,37 @@ public:
 		return *((T*)DataPtr + index);
 	}
 
+	// make space for 'count' items without changing Num()
+	void Reserve(int count)
+	{
+		CArray::Reserve(count, sizeof(T), GetAlignment(), GetRelocate());
+	}
+
 	int Add(int count = 1)
 	{
 		int index = DataCount;
-		CArray::Insert(index, count, sizeof(T));
+		CArray::Insert(index, count, sizeof(T), GetAlignment(), true, GetRelocate());
+		return index;
+	}
+
+	// add uninitialized items; should be used for plain data, which will be
+	// overwritten by caller
+	int AddNoInit(int count = 1)
+	{
+		int index = DataCount;
+		CArray::Insert(index, count, sizeof(T), GetAlignment(), false, GetRelocate());
 		return index;
 	}
 
 	void Insert(int index, int count = 1)
 	{
-		CArray::Insert(index, count, sizeof(T));
+		CArray::Insert(index, count, sizeof(T), GetAlignment(), true, GetRelocate());
 	}
 
 	void Remove(int index, int count = 1)
 	{
-		// destruct specified array items
-		T *P, *P2;
-		for (P = (T*)DataPtr + index, P2 = P + count; P < P2; P++)
-			P->~T();
-		// remove items from array
-		CArray::Remove(index, count, sizeof(T));
+		DestructItems(index, count);
+		CArray::Remove(index, count, sizeof(T), GetRelocate());
 	}
 
 	int AddItem(const T& item)
@@ -546,25 +1080,43 @@ public:
 
 	void Empty(int count = 0)
 	{
-		CArray::Empty(count, sizeof(T));
+		DestructItems(0, DataCount);
+		DataCount = 0;
+		CArray::Empty(count, sizeof(T), GetAlignment());
+	}
+
+	// serialize array items without array size (array should be already resized
+	// when loading)
+	void SerializeItems(CArchive &Ar)
+	{
+		if (!DataCount) return;
+		if (TTypeInfo<T>::IsPod)
+		{
+			Ar.Serialize(DataPtr, DataCount * sizeof(T));
+			return;
+		}
+		T *Ptr = (T*)DataPtr;
+		for (int i = 0; i < DataCount; i++)
+			Ar << *Ptr++;
 	}
 
 	// serializer
 	friend CArchive& operator<<(CArchive &Ar, TArray &A)
 	{
 		guard(TArray<<);
-		T *Ptr;
 		if (Ar.IsLoading)
 		{
 			// array loading
 			A.Empty();
 			int Count;
 			Ar << AR_INDEX(Count);
+			// items will be overwritten by serializer, so do not fill
+			// plain data with zeros
+			A.DataPtr   = NULL;
 			if (Count)
-				Ptr = (T*)appMalloc(sizeof(T) * Count);
-			else
-				Ptr = NULL;
-			A.DataPtr   = Ptr;
+				A.DataPtr = TTypeInfo<T>::IsPod
+					? appMallocNoInit(sizeof(T) * Count, GetAlignment())
+					: appMalloc(sizeof(T) * Count, GetAlignment());
 			A.DataCount = Count;
 			A.MaxCount  = Count;
 		}
@@ -572,23 +1124,81 @@ public:
 		{
 			// array saving
 			Ar << AR_INDEX(A.DataCount);
-			Ptr = (T*)A.DataPtr;
 		}
-		for (int i = 0; i < A.DataCount; i++)
-			Ar << *Ptr++;
+		A.SerializeItems(Ar);
 		return Ar;
 		unguard;
 	}
+
+private:
+	void DestructItems(int index, int count)
+	{
+		T *P, *P2;
+		for (P = (T*)DataPtr + index, P2 = P + count; P < P2; P++)
+			P->~T();
+	}
+
+	// array should be empty
+	void CopyItems(const TArray &Other)
+	{
+		if (!Other.DataCount) return;
+		Reserve(Other.DataCount);
+		if (TTypeInfo<T>::IsPod)
+		{
+			memcpy(DataPtr, Other.DataPtr, Other.DataCount * sizeof(T));
+		}
+		else
+		{
+			for (int i = 0; i < Other.DataCount; i++)
+				new ((T*)DataPtr + i) T(Other[i]);
+		}
+		DataCount = Other.DataCount;
+	}
+
+	static void RelocateItems(void *Dst, void *Src, int Count)
+	{
+		T *D = (T*)Dst;
+		T *S = (T*)Src;
+		int i;
+		// choose direction, so source items are not overwritten before they are moved
+		if (D < S)
+		{
+			for (i = 0; i < Count; i++)
+			{
+				new (D + i) T(S[i]);
+				S[i].~T();
+			}
+		}
+		else
+		{
+			for (i = Count - 1; i >= 0; i--)
+			{
+				new (D + i) T(S[i]);
+				S[i].~T();
+			}
+		}
+	}
+
+	static FORCEINLINE RelocateFunc GetRelocate()
+	{
+		return TTypeInfo<T>::IsRelocatable ? NULL : RelocateItems;
+	}
+
+	static FORCEINLINE int GetAlignment()
+	{
+		int align = max(Alignment, (int)ALIGNOF(T));
+		return max(align, MALLOC_ALIGNMENT);
+	}
 };
 
 
-template<class T> FORCEINLINE void* operator new(size_t size, TArray<T> &Array)
+template<class T, int A> FORCEINLINE void* operator new(size_t size, TArray<T, A> &Array)
 {
-	guard(TArray::operator new);
+	guardSlow(TArray::operator new);
 	assert(size == sizeof(T));
 	int index = Array.Add(1);
 	return &Array[index];
-	unguard;
+	unguardSlow;
 }
 
 
@@ -597,6 +1207,7 @@ template<class T> FORCEINLINE void* operator new(size_t size, TArray<T> &Array)
 #include "Commands.h"
 #include "ScriptParser.h"
 #include "CoreTypeinfo.h"
+#include "Compression.h"
 #include "Object.h"
 
 typedef CVec3 CColor3f;
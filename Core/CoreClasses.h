@@ -22,4 +22,11 @@ class CObject;
 #define REGISTER_CORE_CLASSES
 
 
+/*-----------------------------------------------------------------------------
+	Static typeinfo
+-----------------------------------------------------------------------------*/
+
+#define CORE_TYPEINFO_TABLE
+
+
 #endif // __CORECLASSES_H__
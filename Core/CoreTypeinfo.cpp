@@ -2,42 +2,26 @@
 
 //#define SHOW_TYPEINFO	1				// define to 1 for debugging typeinfo reading
 
-/*-----------------------------------------------------------------------------
-	Type serialization consts
-	Should correspond to TYPE_XXX and PROP_XXX declarations from "Tools/ucc"
------------------------------------------------------------------------------*/
-
-enum
-{
-	TYPE_SCALAR,
-	TYPE_ENUM,
-	TYPE_STRUCT,
-	TYPE_CLASS
-};
-
-
-#define PROP_EDITABLE		1
-#define PROP_EDITCONST		2
-#define PROP_NORESIZE		4
-#define PROP_NOADD			8
-#define PROP_NOEXPORT		16
-#define PROP_TRANSIENT		32
-#define PROP_NATIVE			64
-
-
 /*-----------------------------------------------------------------------------
 	CType class
 -----------------------------------------------------------------------------*/
 
+#define TYPE_HASH_SIZE		1024
+
 static TArray<CType*>	GTypes;
+static CType			*GTypeHash[TYPE_HASH_SIZE];
 static CMemoryChain		*TypeChain;
 
+// types with special serialization
+static const CType		*StringType;
+static const CType		*ObjectType;
+
 
 const CType *FindType(const char *Name, bool ShouldExist)
 {
-	for (int i = 0; i < GTypes.Num(); i++)
-		if (!strcmp(GTypes[i]->TypeName, Name))
-			return GTypes[i];
+	for (const CType *Type = GTypeHash[appStrHash(Name) & (TYPE_HASH_SIZE-1)]; Type; Type = Type->HashNext)
+		if (!strcmp(Type->TypeName, Name))
+			return Type;
 	if (ShouldExist)
 		appError("unknown type \"%s\"", Name);
 	return NULL;
@@ -45,11 +29,13 @@ const CType *FindType(const char *Name, bool ShouldExist)
 
 
 CType::CType(const char *AName, unsigned ASize, unsigned AAlign)
-:	TypeName(appStrdup(AName, TypeChain))
+:	TypeName(AName)
 ,	TypeSize(ASize)
 ,	TypeAlign(AAlign)
 ,	IsStruc(false)
 ,	IsEnum(false)
+,	IsPod(false)
+,	HashNext(NULL)
 {
 	guard(RegisterType);
 
@@ -58,6 +44,10 @@ CType::CType(const char *AName, unsigned ASize, unsigned AAlign)
 	if (FindType(AName, false))
 		appError("Type %s is already registered", AName);
 	GTypes.AddItem(this);
+	// link to hash chain
+	int Hash = appStrHash(AName) & (TYPE_HASH_SIZE-1);
+	HashNext = GTypeHash[Hash];
+	GTypeHash[Hash] = this;
 
 	unguard;
 }
@@ -81,7 +71,7 @@ bool CType::ReadProp(const CProperty *Prop, const char *Text, void *Data) const
 
 void CEnum::AddValue(const char *Name)
 {
-	Names.AddItem(appStrdup(Name, TypeChain));
+	Names.AddItem(Name);
 }
 
 
@@ -142,7 +132,36 @@ CProperty *CStruct::AddField(const char *AName, const char *ATypeName, int Array
 
 void CStruct::Finalize()
 {
+	guard(CStruct::Finalize);
+
 	TypeSize = Align(TypeSize, TypeAlign);
+
+	// flatten property list: parent properties, then own ones
+	AllProps.Empty(TotalProps);
+	if (ParentStruct)
+		for (int i = 0; i < ParentStruct->AllProps.Num(); i++)
+			AllProps.AddItem(ParentStruct->AllProps[i]);
+	for (const CProperty *Prop = FirstProp; Prop; Prop = Prop->NextProp)
+		AllProps.AddItem(Prop);
+	assert(AllProps.Num() == TotalProps);
+
+	// build name hash; table is at least 2 times larger than property count,
+	// so it always has empty slots
+	int HashSize = 4;
+	while (HashSize < TotalProps * 2)
+		HashSize *= 2;
+	PropHash.Empty(HashSize);
+	PropHash.Add(HashSize);
+	for (int i = 0; i < AllProps.Num(); i++)
+	{
+		const CProperty *Prop = AllProps[i];
+		int Slot = appStrHash(Prop->Name) & (HashSize - 1);
+		while (PropHash[Slot] && strcmp(PropHash[Slot]->Name, Prop->Name) != 0)
+			Slot = (Slot + 1) & (HashSize - 1);
+		PropHash[Slot] = Prop;		// own property hides parent property with the same name
+	}
+
+	unguardf(("%s", TypeName));
 }
 
 
@@ -301,41 +320,15 @@ bool CStruct::ReadText(CSimpleParser &Text, void *Data, int Level) const
 
 const CProperty *CStruct::FindProp(const char *Name) const
 {
-	// check for local property
-	for (const CProperty *Prop = FirstProp; Prop; Prop = Prop->NextProp)
-		if (!strcmp(Prop->Name, Name))
-			return Prop;
-	// check for parent structure property
-	if (ParentStruct)
-		return ParentStruct->FindProp(Name);
-	// not found ...
+	int HashSize = PropHash.Num();
+	if (!HashSize) return NULL;		// not finalized
+	for (int Slot = appStrHash(Name) & (HashSize - 1); PropHash[Slot]; Slot = (Slot + 1) & (HashSize - 1))
+		if (!strcmp(PropHash[Slot]->Name, Name))
+			return PropHash[Slot];
 	return NULL;
 }
 
 
-const CProperty *CStruct::IterateProps(int Index) const
-{
-	if (Index < 0 || Index >= TotalProps)
-		return NULL;				// out of property array bounds
-	// check parent class
-	int numParentProps = TotalProps - NumProps;
-	if (Index < numParentProps)
-	{
-		assert(ParentStruct);
-		return ParentStruct->IterateProps(Index);
-	}
-	// find property
-	const CProperty *Prop;
-	int i;
-	for (i = numParentProps, Prop = FirstProp; i < Index; i++, Prop = Prop->NextProp)
-	{
-		// empty
-		assert(Prop);
-	}
-	return Prop;
-}
-
-
 void CStruct::DestructObject(void *Data)
 {
 	guard(CStruct::DestructObject);
@@ -372,12 +365,370 @@ void CStruct::DestructObject(void *Data)
 }
 
 
+/*-----------------------------------------------------------------------------
+	Serialization plan
+-----------------------------------------------------------------------------*/
+
+static void AddSpan(TArray<CSerializeOp> &Ops, int Offset, int Size, int ValueSize)
+{
+	// combine with previous block, when data is contiguous
+	if (Ops.Num())
+	{
+		CSerializeOp &Prev = Ops[Ops.Num()-1];
+		if (Prev.Op == SOP_SPAN && Prev.Offset + Prev.Size == Offset
+#if !LITTLE_ENDIAN
+			&& Prev.ValueSize == ValueSize
+#endif
+			)
+		{
+			Prev.Size += Size;
+			return;
+		}
+	}
+	CSerializeOp &Op = Ops[Ops.Add()];
+	Op.Op        = SOP_SPAN;
+	Op.Offset    = Offset;
+	Op.Size      = Size;
+	Op.ValueSize = ValueSize;
+}
+
+
+static CSerializeOp& AddOp(TArray<CSerializeOp> &Ops, int Op, int Offset, int Size)
+{
+	CSerializeOp &R = Ops[Ops.Add()];
+	R.Op     = Op;
+	R.Offset = Offset;
+	R.Size   = Size;
+	R.Count  = 1;
+	return R;
+}
+
+
+static unsigned HashString(const char *Str, unsigned Hash)
+{
+	return appCrc32(Str, strlen(Str) + 1, Hash);
+}
+
+
+void CStruct::BuildSerializePlan()
+{
+	guard(CStruct::BuildSerializePlan);
+	if (PlanState == 2) return;
+	if (PlanState == 1)
+		appError("Recursive structure");
+	PlanState = 1;
+	unsigned Hash = HashString(TypeName, 0);
+	Plan.Empty();
+	BuildPlan(Plan, 0, Hash);
+	LayoutHash  = Hash;
+	IsPodLayout = (Plan.Num() == 1 && Plan[0].Op == SOP_SPAN && Plan[0].Size == TypeSize);
+#if !LITTLE_ENDIAN
+	IsPodLayout = IsPodLayout && Plan[0].ValueSize == 1;
+#endif
+	// field directory: separate plan for each property, data of neighbour
+	// properties is not combined
+	Fields.Empty();
+	FieldOps.Empty();
+	for (int i = 0; /* empty */ ; i++)
+	{
+		const CProperty *Prop = IterateProps(i);
+		if (!Prop) break;
+		if (Prop->IsTransient || Prop->IsNative)
+			continue;
+		TArray<CSerializeOp> Ops;
+		unsigned FieldHash = 0;
+		if (!BuildPropPlan(Ops, Prop, 0, FieldHash))
+			continue;
+		CSerializeField &F = Fields[Fields.Add()];
+		F.Prop    = Prop;
+		F.Hash    = FieldHash;
+		F.FirstOp = FieldOps.Num();
+		F.NumOps  = Ops.Num();
+		for (int j = 0; j < Ops.Num(); j++)
+			FieldOps.AddItem(Ops[j]);
+	}
+	PlanState = 2;
+	unguardf(("%s", TypeName));
+}
+
+
+void CStruct::BuildPlan(TArray<CSerializeOp> &Ops, int BaseOffset, unsigned &Hash) const
+{
+	for (int i = 0; /* empty */ ; i++)
+	{
+		const CProperty *Prop = IterateProps(i);
+		if (!Prop) break;
+		if (Prop->IsTransient || Prop->IsNative)
+			continue;
+		BuildPropPlan(Ops, Prop, BaseOffset, Hash);
+	}
+}
+
+
+bool CStruct::BuildPropPlan(TArray<CSerializeOp> &Ops, const CProperty *Prop, int BaseOffset, unsigned &Hash)
+{
+	const CType *Type = Prop->TypeInfo;
+	int Offset = BaseOffset + Prop->StructOffset;
+	// make structure plan before use
+	CStruct *Struc = NULL;
+	if (Type->IsStruc)
+	{
+		Struc = (CStruct*)Type;
+		Struc->BuildSerializePlan();
+	}
+
+	if (Prop->IsDynamicArray())
+	{
+		CSerializeOp &Op = AddOp(Ops, SOP_ARRAY, Offset, Type->TypeSize);
+		if (Type->IsPod)
+		{
+			Op.ItemOp    = SOP_SPAN;
+			Op.ValueSize = Type->TypeSize;
+		}
+		else if (Type == ObjectType)
+		{
+			Op.ItemOp = SOP_OBJECT;
+		}
+		else if (Struc && Struc->IsPodLayout)
+		{
+			Op.ItemOp    = SOP_SPAN;
+			Op.ValueSize = 1;
+		}
+		else if (Struc)
+		{
+			Op.ItemOp = SOP_STRUCT;
+			Op.Struc  = Struc;
+		}
+		else
+		{
+			// raw pointers could not be serialized
+			Ops.Remove(Ops.Num()-1);
+			return false;
+		}
+	}
+	else
+	{
+		int Count = Prop->IsStaticArray() ? Prop->ArrayDim : 1;
+		if (Type == StringType)
+		{
+			AddOp(Ops, SOP_STRING, Offset, Prop->ArrayDim);
+		}
+		else if (Type->IsPod)
+		{
+			AddSpan(Ops, Offset, Type->TypeSize * Count, Type->TypeSize);
+		}
+		else if (Type == ObjectType)
+		{
+			AddOp(Ops, SOP_OBJECT, Offset, Type->TypeSize).Count = Count;
+		}
+		else if (Struc && Count == 1)
+		{
+			// embed structure plan, so its data could be combined with neighbours
+			Struc->BuildPlan(Ops, Offset, Hash);
+		}
+		else if (Struc && Struc->IsPodLayout)
+		{
+			AddSpan(Ops, Offset, Type->TypeSize * Count, 1);
+		}
+		else if (Struc)
+		{
+			CSerializeOp &Op = AddOp(Ops, SOP_STRUCT, Offset, Type->TypeSize);
+			Op.Count = Count;
+			Op.Struc = Struc;
+		}
+		else
+		{
+			return false;					// raw pointer
+		}
+	}
+	// update layout hash
+	Hash = HashString(Prop->Name, Hash);
+	Hash = HashString(Type->TypeName, Hash);
+	Hash = appCrc32(&Prop->ArrayDim, sizeof(int), Hash);
+	if (Struc) Hash = appCrc32(&Struc->LayoutHash, sizeof(unsigned), Hash);
+	return true;
+}
+
+
+static FORCEINLINE void SerializeSpan(CArchive &Ar, byte *Data, int Size, int ValueSize)
+{
+#if LITTLE_ENDIAN
+	Ar.Serialize(Data, Size);
+#else
+	for (int i = 0; i < Size; i += ValueSize)
+		Ar.ByteOrderSerialize(Data + i, ValueSize);
+#endif
+}
+
+
+void CStruct::SerializeProps(CArchive &Ar, void *Data) const
+{
+	guard(CStruct::SerializeProps);
+	assert(PlanState == 2);
+	SerializeOps(Ar, Data, (CSerializeOp*)Plan.DataPtr, Plan.Num());
+	unguardf(("%s", TypeName));
+}
+
+
+void CStruct::SerializeOps(CArchive &Ar, void *Data, const CSerializeOp *Ops, int NumOps)
+{
+	for (int i = 0; i < NumOps; i++)
+	{
+		const CSerializeOp &Op = Ops[i];
+		byte *Ptr = (byte*)Data + Op.Offset;
+		int j;
+		switch (Op.Op)
+		{
+		case SOP_SPAN:
+			SerializeSpan(Ar, Ptr, Op.Size, Op.ValueSize);
+			break;
+		case SOP_STRING:
+			SerializeString(Ar, (char*)Ptr, Op.Size);
+			break;
+		case SOP_OBJECT:
+			for (j = 0; j < Op.Count; j++)
+				Ar << ((CObject**)Ptr)[j];
+			break;
+		case SOP_STRUCT:
+			for (j = 0; j < Op.Count; j++, Ptr += Op.Size)
+				Op.Struc->SerializeProps(Ar, Ptr);
+			break;
+		case SOP_ARRAY:
+			SerializeArray(Ar, *(CArray*)Ptr, Op);
+			break;
+		}
+	}
+}
+
+
+/*
+ *	Field directory layout:
+ *		int		NumFields
+ *		{
+ *			string	Name		property name
+ *			unsigned Hash		CSerializeField::Hash
+ *			int		Size		size of property data
+ *		} [NumFields]
+ *	Property data goes before directory, in the same order.
+ */
+
+int CStruct::SaveFields(CArchive &Ar, void *Data) const
+{
+	guard(CStruct::SaveFields);
+	assert(PlanState == 2);
+	TArray<int> Sizes;
+	int i;
+	for (i = 0; i < Fields.Num(); i++)
+	{
+		const CSerializeField &F = Fields[i];
+		int Pos = Ar.Tell();
+		SerializeOps(Ar, Data, (CSerializeOp*)FieldOps.DataPtr + F.FirstOp, F.NumOps);
+		Sizes.AddItem(Ar.Tell() - Pos);
+	}
+	int DirPos = Ar.Tell();
+	int NumFields = Fields.Num();
+	Ar << NumFields;
+	for (i = 0; i < Fields.Num(); i++)
+	{
+		const CSerializeField &F = Fields[i];
+		TString<256> Name;
+		Name = F.Prop->Name;
+		unsigned Hash = F.Hash;
+		Ar << Name << Hash << Sizes[i];
+	}
+	return DirPos;
+	unguardf(("%s", TypeName));
+}
+
+
+void CStruct::LoadFields(CArchive &Ar, void *Data, int DirPos) const
+{
+	guard(CStruct::LoadFields);
+	assert(PlanState == 2);
+	int DataPos = Ar.Tell();
+	Ar.Seek(DirPos);
+	int NumFields;
+	Ar << NumFields;
+	int NumLoaded = 0;
+	for (int i = 0; i < NumFields; i++)
+	{
+		TString<256> Name;
+		unsigned Hash;
+		int Size;
+		Ar << Name << Hash << Size;
+		// find property with the same name and layout
+		const CSerializeField *F = NULL;
+		for (int j = 0; j < Fields.Num(); j++)
+		{
+			if (!strcmp(Fields[j].Prop->Name, *Name))
+			{
+				if (Fields[j].Hash == Hash) F = &Fields[j];
+				break;
+			}
+		}
+		if (F)
+		{
+			int EntryPos = Ar.Tell();
+			Ar.Seek(DataPos);
+			SerializeOps(Ar, Data, (CSerializeOp*)FieldOps.DataPtr + F->FirstOp, F->NumOps);
+			if (Ar.Tell() != DataPos + Size)
+				appError("%s.%s: wrong property data size", TypeName, *Name);
+			Ar.Seek(EntryPos);
+			NumLoaded++;
+		}
+		DataPos += Size;
+	}
+	appNotify("%s: properties were changed, loaded %d of %d saved properties", TypeName, NumLoaded, NumFields);
+	unguardf(("%s", TypeName));
+}
+
+
+void CStruct::SerializeArray(CArchive &Ar, CArray &Arr, const CSerializeOp &Op)
+{
+	int Count, i;
+	if (Ar.IsLoading)
+	{
+		// destroy old data and allocate zero-filled items
+		byte *Ptr = (byte*)Arr.DataPtr;
+		if (Op.ItemOp == SOP_STRUCT)
+			for (i = 0; i < Arr.DataCount; i++, Ptr += Op.Size)
+				((CStruct*)Op.Struc)->DestructObject(Ptr);
+		Ar << AR_INDEX(Count);
+		Arr.Empty(Count, Op.Size);
+		Arr.DataCount = Count;
+		// spans are overwritten completely, other items should be zero-filled
+		if (Op.ItemOp != SOP_SPAN && Count)
+			memset(Arr.DataPtr, 0, Count * Op.Size);
+	}
+	else
+	{
+		Count = Arr.DataCount;
+		Ar << AR_INDEX(Count);
+	}
+	byte *Ptr = (byte*)Arr.DataPtr;
+	switch (Op.ItemOp)
+	{
+	case SOP_SPAN:
+		SerializeSpan(Ar, Ptr, Count * Op.Size, Op.ValueSize);
+		break;
+	case SOP_OBJECT:
+		for (i = 0; i < Count; i++)
+			Ar << ((CObject**)Ptr)[i];
+		break;
+	case SOP_STRUCT:
+		for (i = 0; i < Count; i++, Ptr += Op.Size)
+			Op.Struc->SerializeProps(Ar, Ptr);
+		break;
+	}
+}
+
+
 /*-----------------------------------------------------------------------------
 	CProperty class
 -----------------------------------------------------------------------------*/
 
 CProperty::CProperty(CStruct *AOwner, const char *AName, const CType *AType, int AArrayDim)
-:	Name(appStrdup(AName, TypeChain))
+:	Name(AName)
 ,	TypeInfo(AType)
 ,	ArrayDim(AArrayDim)
 ,	NextProp(NULL)
@@ -389,6 +740,8 @@ CProperty::CProperty(CStruct *AOwner, const char *AName, const CType *AType, int
 ,	IsDeleteAllowed(true)
 ,	Comment(NULL)
 ,	Category(NULL)
+,	IsTransient(false)
+,	IsNative(false)
 {}
 
 
@@ -396,6 +749,29 @@ CProperty::CProperty(CStruct *AOwner, const char *AName, const CType *AType, int
 	Typeinfo file support
 -----------------------------------------------------------------------------*/
 
+static void SetupProp(CProperty *Prop, unsigned Flags, const char *Comment, const char *Category)
+{
+	Prop->IsEditable   = (Flags & PROP_EDITABLE)  != 0;
+	Prop->IsReadonly   = (Flags & PROP_EDITCONST) != 0;
+	Prop->IsAddAllowed = (Flags & (PROP_NOADD|PROP_NORESIZE)) == 0;
+	Prop->IsDeleteAllowed = (Flags & PROP_NORESIZE) == 0;
+	Prop->Category     = (Prop->IsEditable && Category[0]) ? Category : NULL;
+	Prop->Comment      = (Prop->IsEditable && Comment[0])  ? Comment  : NULL;
+	Prop->IsTransient  = (Flags & PROP_TRANSIENT) != 0;
+	Prop->IsNative     = (Flags & PROP_NATIVE) != 0;
+}
+
+
+static const CStruct *FindParentStruct(const char *TypeName, const char *ParentName)
+{
+	if (!ParentName[0]) return NULL;
+	const CType *Parent = FindType(ParentName);
+	if (!Parent->IsStruc)
+		appError("%s derived from non-structure type %s", TypeName, ParentName);
+	return (CStruct*)Parent;
+}
+
+
 void ParseTypeinfoFile(CArchive &Ar)
 {
 	guard(ParseTypeinfoFile);
@@ -418,7 +794,7 @@ void ParseTypeinfoFile(CArchive &Ar)
 
 		case TYPE_ENUM:
 			{
-				CEnum *Enum = new (TypeChain) CEnum(TypeName);
+				CEnum *Enum = new (TypeChain) CEnum(appStrdup(TypeName, TypeChain));
 #if SHOW_TYPEINFO
 				appPrintf("Reading enum [%s]\n", *TypeName);
 #endif
@@ -430,7 +806,7 @@ void ParseTypeinfoFile(CArchive &Ar)
 #if SHOW_TYPEINFO
 					appPrintf("  . [%s]\n", *EnumItem);
 #endif
-					Enum->AddValue(EnumItem);
+					Enum->AddValue(appStrdup(EnumItem, TypeChain));
 				}
 			}
 			break;
@@ -438,26 +814,11 @@ void ParseTypeinfoFile(CArchive &Ar)
 		case TYPE_CLASS:
 		case TYPE_STRUCT:
 			{
-				CStruct *Struc;
-				const CStruct *Parent = NULL;
 				TString<256> ParentName;
 				Ar << ParentName;
-				if (ParentName[0])
-				{
-					const CType *Parent2 = FindType(ParentName);
-					if (!Parent2->IsStruc)
-						appError("%s derived from non-structure type %s", *TypeName, *ParentName);
-					Parent = (CStruct*)Parent2;
-				}
-
-				if (typeKind == TYPE_CLASS)
-				{
-					Struc = new (TypeChain) CStruct(TypeName, Parent);	//!! here: use CClass ?
-				}
-				else
-				{
-					Struc = new (TypeChain) CStruct(TypeName, Parent);
-				}
+				const CStruct *Parent = FindParentStruct(TypeName, ParentName);
+				//!! here: use CClass for TYPE_CLASS ?
+				CStruct *Struc = new (TypeChain) CStruct(appStrdup(TypeName, TypeChain), Parent);
 #if SHOW_TYPEINFO
 				appPrintf("struct [%s] : [%s]\n", *TypeName, *ParentName);
 #endif
@@ -479,16 +840,12 @@ void ParseTypeinfoFile(CArchive &Ar)
 						*FieldName, *FieldType, ArrayDim, Flags, *Comment, *EditorGroup);
 #endif
 					// create property
-					CProperty *Prop = Struc->AddField(FieldName, FieldType, ArrayDim);
-					// fill other fields
-					Prop->IsEditable   = (Flags & PROP_EDITABLE)  != 0;
-					Prop->IsReadonly   = (Flags & PROP_EDITCONST) != 0;
-					Prop->IsAddAllowed = (Flags & (PROP_NOADD|PROP_NORESIZE)) == 0;
-					Prop->IsDeleteAllowed = (Flags & PROP_NORESIZE) == 0;
-					Prop->Category     = (Prop->IsEditable && EditorGroup[0]) ?
-										  appStrdup(EditorGroup, TypeChain) : NULL;
-					Prop->Comment      = (Prop->IsEditable && Comment[0]) ?
-										  appStrdup(Comment, TypeChain) : NULL;
+					CProperty *Prop = Struc->AddField(appStrdup(FieldName, TypeChain), FieldType, ArrayDim);
+					// fill other fields; comment and category are used by editor only
+					bool Editable = (Flags & PROP_EDITABLE) != 0;
+					SetupProp(Prop, Flags,
+						(Editable && Comment[0])     ? appStrdup(Comment, TypeChain)     : "",
+						(Editable && EditorGroup[0]) ? appStrdup(EditorGroup, TypeChain) : "");
 				}
 				Struc->Finalize();
 			}
@@ -505,6 +862,61 @@ void ParseTypeinfoFile(CArchive &Ar)
 }
 
 
+/*-----------------------------------------------------------------------------
+	Static typeinfo tables support
+-----------------------------------------------------------------------------*/
+
+static void RegisterTypeinfo(const CTypeinfoDecl *Table)
+{
+	guard(RegisterTypeinfo);
+
+	for (const CTypeinfoDecl *Decl = Table; Decl->Name; Decl++)
+	{
+		guard(RegisterType);
+
+		switch (Decl->Kind)
+		{
+		case TYPE_ENUM:
+			{
+				CEnum *Enum = new (TypeChain) CEnum(Decl->Name);
+				for (const char *const *Value = Decl->Values; *Value; Value++)
+					Enum->AddValue(*Value);
+			}
+			break;
+
+		case TYPE_CLASS:
+		case TYPE_STRUCT:
+			{
+				CStruct *Struc = new (TypeChain) CStruct(Decl->Name, FindParentStruct(Decl->Name, Decl->Parent));
+				for (const CTypeinfoField *Field = Decl->Fields; Field->Name; Field++)
+				{
+					CProperty *Prop = Struc->AddField(Field->Name, Field->TypeName, Field->ArrayDim);
+					SetupProp(Prop, Field->Flags, Field->Comment, Field->Category);
+					// verify layout, computed from script, with C++ declaration
+					if (Field->NativeOffset >= 0 && (int)Prop->StructOffset != Field->NativeOffset)
+						appError("%s.%s: script offset is %d, native offset is %d",
+							Decl->Name, Field->Name, Prop->StructOffset, Field->NativeOffset);
+				}
+				Struc->Finalize();
+				// structures are used in arrays, so size should match exactly; classes
+				// could have extra native fields
+				if (Decl->NativeSize && (Decl->Kind == TYPE_STRUCT ? Struc->TypeSize != Decl->NativeSize
+																	: Struc->TypeSize > Decl->NativeSize))
+					appError("%s: script size is %d, native size is %d", Decl->Name, Struc->TypeSize, Decl->NativeSize);
+			}
+			break;
+
+		default:
+			appError("unknown kind %d", Decl->Kind);
+		}
+
+		unguardf(("%s", Decl->Name));
+	}
+
+	unguard;
+}
+
+
 /*-----------------------------------------------------------------------------
 	Support for standard types
 -----------------------------------------------------------------------------*/
@@ -522,7 +934,9 @@ inline bool atob(const char *str)
 	public:										\
 		C##TypeName##Type()						\
 		:	CType(#TypeName, sizeof(NatType))	\
-		{}										\
+		{										\
+			IsPod = true;						\
+		}										\
 		virtual bool WriteProp(const CProperty *Prop, COutputDevice &Out, void *Data) const \
 		{										\
 			Out.Printf(WriteFormat, *(NatType*)Data); \
@@ -566,12 +980,12 @@ public:
 };
 
 
-void InitTypeinfo(CArchive &Ar)
+static void InitStandardTypes()
 {
 	TypeChain = new CMemoryChain;
 	// register standard types
 #define N(Name)					new (TypeChain) C##Name##Type;
-	new (TypeChain) CStringType;
+	StringType = new (TypeChain) CStringType;
 	N(bool)
 	N(byte)
 	N(short)
@@ -584,6 +998,32 @@ void InitTypeinfo(CArchive &Ar)
 	T2(pointer, void*)
 #undef T2
 #undef N
-	// read typeinfo file
+	ObjectType = new (TypeChain) CType("object", sizeof(CObject*));
+}
+
+
+static void BuildSerializePlans()
+{
+	for (int i = 0; i < GTypes.Num(); i++)
+		if (GTypes[i]->IsStruc)
+			((CStruct*)GTypes[i])->BuildSerializePlan();
+}
+
+
+void InitTypeinfo(CArchive &Ar)
+{
+	MEM_TAG(MEM_Typeinfo);
+	InitStandardTypes();
 	ParseTypeinfoFile(Ar);
+	BuildSerializePlans();
+}
+
+
+void InitTypeinfo(const CTypeinfoDecl *const *Tables)
+{
+	MEM_TAG(MEM_Typeinfo);
+	InitStandardTypes();
+	for ( ; *Tables; Tables++)
+		RegisterTypeinfo(*Tables);
+	BuildSerializePlans();
 }
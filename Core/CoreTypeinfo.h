@@ -1,5 +1,6 @@
 // forwards
 class CProperty;
+class CStruct;
 //class CObject;
 
 
@@ -13,6 +14,8 @@ class CProperty;
 class CType
 {
 public:
+	// note: type, property and enum value names are not copied, they should
+	// be persistent
 	CType(const char *AName, unsigned ASize, unsigned AAlign = 0);
 
 	/**
@@ -38,12 +41,25 @@ public:
 	 *	Set to "true" for enumeration types
 	 */
 	bool		IsEnum;
+	/**
+	 *	Set to "true" for numeric types, which are serialized as raw data (with
+	 *	byte order conversion only)
+	 */
+	bool		IsPod;
 	/**
 	 *	Reading/writting properties as text. Default implementation does nothing and
 	 *	returns false. Overriden method should return true.
 	 */
 	virtual bool WriteProp(const CProperty *Prop, COutputDevice &Out, void *Data) const;
 	virtual bool ReadProp(const CProperty *Prop, const char *Text, void *Data) const;
+
+protected:
+	/**
+	 *	Next type with the same name hash (type registry)
+	 */
+	CType		*HashNext;
+
+	friend const CType *FindType(const char *Name, bool ShouldExist);
 };
 
 
@@ -57,6 +73,7 @@ public:
 	:	CType(AName, 1, 1)
 	{
 		IsEnum = true;
+		IsPod  = true;
 	}
 
 	void AddValue(const char *Name);
@@ -65,6 +82,42 @@ public:
 };
 
 
+/**
+ *	Single operation of structure serialization plan
+ */
+enum
+{
+	SOP_SPAN,						// raw data block
+	SOP_STRING,						// TString<Size>
+	SOP_OBJECT,						// Count links to objects
+	SOP_STRUCT,						// Count structures, serialized with Struc plan
+	SOP_ARRAY						// TArray<>, items are serialized with ItemOp
+};
+
+struct CSerializeOp
+{
+	byte			Op;				// SOP_...
+	byte			ItemOp;			// SOP_ARRAY: SOP_SPAN, SOP_OBJECT or SOP_STRUCT
+	short			ValueSize;		// SOP_SPAN: size of single numeric value (for byte order)
+	int				Offset;			// offset of data in structure
+	int				Size;			// SOP_SPAN: size of data, SOP_STRING: string length,
+									// SOP_STRUCT, SOP_ARRAY: size of single item
+	int				Count;			// SOP_OBJECT, SOP_STRUCT: number of items
+	const CStruct	*Struc;			// SOP_STRUCT, SOP_ARRAY with structure items
+};
+
+/**
+ *	Serialized property of structure, entry of field directory
+ */
+struct CSerializeField
+{
+	const CProperty	*Prop;
+	unsigned		Hash;			// hash of name, type and layout of property
+	int				FirstOp;		// serialization operations in CStruct::FieldOps
+	int				NumOps;
+};
+
+
 /**
  *	Structure declaration
  */
@@ -77,12 +130,15 @@ public:
 	,	NumProps(0)
 	,	TotalProps(0)
 	,	ParentStruct(AParent)
+	,	LayoutHash(0)
+	,	PlanState(0)
+	,	IsPodLayout(false)
 	{
 		IsStruc = true;
 		// take into account parent class definition
 		if (ParentStruct)
 		{
-			TotalProps = ParentStruct->NumProps;
+			TotalProps = ParentStruct->TotalProps;
 			TypeSize   = ParentStruct->TypeSize;
 			TypeAlign  = ParentStruct->TypeAlign;
 		}
@@ -90,17 +146,27 @@ public:
 
 	// structure creation
 	CProperty *AddField(const char *AName, const char *ATypeName, int ArraySize = 0);
+	/**
+	 *	Should be called after adding all fields: computes structure size and builds
+	 *	property lookup tables
+	 */
 	void Finalize();
 	/**
-	 *	Search for specific field. When field does not exists, return NULL
+	 *	Search for specific field, including fields of parent structures. When field
+	 *	does not exists, return NULL
 	 */
 	const CProperty *FindProp(const char *Name) const;
 	/**
 	 *	Field enumeration
-	 *	Properly handles inheritance from parent classes.
+	 *	Properly handles inheritance from parent classes: parent properties goes first.
 	 *	Returns NULL when no property with such index exists.
 	 */
-	const CProperty *IterateProps(int Index) const;
+	const CProperty *IterateProps(int Index) const
+	{
+		if (Index < 0 || Index >= AllProps.Num())
+			return NULL;
+		return AllProps[Index];
+	}
 	/**
 	 * Dump structure information to console (debugging)
 	 */
@@ -118,14 +184,65 @@ public:
 	 * Call (emulate) destructor for data pointer of known type
 	 */
 	void DestructObject(void *Data);
+	/**
+	 * Compile serialization plan. Plan includes all properties, except transient
+	 * and native ones (native properties are serialized by hand-written code).
+	 * Contiguous numeric fields are combined into a single data block.
+	 */
+	void BuildSerializePlan();
+	/**
+	 * Serialize structure using plan; BuildSerializePlan() should be called before.
+	 */
+	void SerializeProps(CArchive &Ar, void *Data) const;
+	/**
+	 * Returns true when structure has properties, serialized with SerializeProps()
+	 */
+	bool HasSerializedProps() const
+	{
+		return Plan.Num() > 0;
+	}
+	/**
+	 * Hash of names, types and order of serialized properties: data, serialized with
+	 * SerializeProps(), could be loaded only by structure with the same hash.
+	 */
+	unsigned GetLayoutHash() const
+	{
+		return LayoutHash;
+	}
+	/**
+	 * Serialize properties one by one, followed by field directory with name hash
+	 * and data size of each property. Returns position of directory. Produces the
+	 * same property data as SerializeProps().
+	 */
+	int SaveFields(CArchive &Ar, void *Data) const;
+	/**
+	 * Load data, written by SaveFields() for another layout of structure: properties
+	 * with the same name and type are loaded, others are keeping their values.
+	 * Property data starts at current archive position.
+	 */
+	void LoadFields(CArchive &Ar, void *Data, int DirPos) const;
 
 protected:
 	const CStruct *ParentStruct;
 	int			NumProps;			// num of props in this struct excluding parent class
 	int			TotalProps;			// num of props including parent class
 	CProperty	*FirstProp;
+	// lookup tables, built by Finalize()
+	TArray<const CProperty*> AllProps;	// all properties, including parent ones
+	TArray<const CProperty*> PropHash;	// AllProps by name, open addressing
+	// serialization plan
+	TArray<CSerializeOp> Plan;
+	TArray<CSerializeField> Fields;
+	TArray<CSerializeOp> FieldOps;
+	unsigned	LayoutHash;
+	byte		PlanState;			// 0 = not built, 1 = building, 2 = ready
+	bool		IsPodLayout;		// whole structure is serialized as a single data block
 
 	bool ReadText(CSimpleParser &Text, void *Data, int Level) const;
+	void BuildPlan(TArray<CSerializeOp> &Ops, int BaseOffset, unsigned &Hash) const;
+	static bool BuildPropPlan(TArray<CSerializeOp> &Ops, const CProperty *Prop, int BaseOffset, unsigned &Hash);
+	static void SerializeOps(CArchive &Ar, void *Data, const CSerializeOp *Ops, int NumOps);
+	static void SerializeArray(CArchive &Ar, CArray &Arr, const CSerializeOp &Op);
 };
 
 
@@ -204,6 +321,11 @@ public:
 	const char *Comment;
 	const char *Category;
 
+	/* serialization properties */
+
+	bool		IsTransient;		// not serialized
+	bool		IsNative;			// serialized by hand-written code
+
 	inline bool IsArray() const
 	{
 		return ArrayDim != 0;
@@ -225,7 +347,62 @@ protected:
 };
 
 
+/*-----------------------------------------------------------------------------
+	Static typeinfo tables
+	Generated by "ucc --cpp" into <Package>Classes.cpp files. Contain the same
+	information as typeinfo file, so typeinfo could be registered without file
+	loading and parsing.
+-----------------------------------------------------------------------------*/
+
+// declaration kinds
+// should correspond to TYPE_XXX declarations from "Tools/ucc"
+enum
+{
+	TYPE_SCALAR,
+	TYPE_ENUM,
+	TYPE_STRUCT,
+	TYPE_CLASS
+};
+
+// property flags
+// should correspond to PROP_XXX declarations from "Tools/ucc"
+#define PROP_EDITABLE		1
+#define PROP_EDITCONST		2
+#define PROP_NORESIZE		4
+#define PROP_NOADD			8
+#define PROP_NOEXPORT		16
+#define PROP_TRANSIENT		32
+#define PROP_NATIVE			64
+
+struct CTypeinfoField
+{
+	const char	*Name;				// NULL for end of list
+	const char	*TypeName;
+	int			ArrayDim;			// the same as CProperty::ArrayDim
+	unsigned	Flags;				// PROP_XXX
+	const char	*Comment;
+	const char	*Category;
+	int			NativeOffset;		// offset in C++ class, -1 when not verified
+};
+
+struct CTypeinfoDecl
+{
+	const char	*Name;				// NULL for end of table
+	int			Kind;				// TYPE_XXX
+	const char	*Parent;			// "" for types without parent
+	const CTypeinfoField *Fields;	// TYPE_STRUCT and TYPE_CLASS
+	const char *const *Values;		// TYPE_ENUM, NULL-terminated
+	int			NativeSize;			// sizeof() of C++ type, 0 when not verified
+};
+
+
 void InitTypeinfo(CArchive &Ar);
+/**
+ * Register typeinfo from static tables instead of file. 'Tables' is NULL-terminated
+ * list, tables should go in dependency order (Core first). Names and comments are
+ * not copied. Layout of structures is verified against C++ declarations.
+ */
+void InitTypeinfo(const CTypeinfoDecl *const *Tables);
 const CType *FindType(const char *Name, bool ShouldExist = true);
 
 inline const CStruct *FindStruct(const char *Name)
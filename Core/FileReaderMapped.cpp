@@ -0,0 +1,169 @@
+#if _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#include "Core.h"
+#include "FileReaderMapped.h"
+
+
+/*-----------------------------------------------------------------------------
+	CMappedFile
+-----------------------------------------------------------------------------*/
+
+// used for empty files, which cannot be mapped
+static const byte EmptyFileData[1] = { 0 };
+
+
+bool CMappedFile::Open(const char *Filename)
+{
+	guard(CMappedFile::Open);
+
+	Close();
+	ArPos = 0;
+
+#if _WIN32
+	HANDLE File = CreateFile(Filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+		FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (File == INVALID_HANDLE_VALUE)
+		return false;
+	LARGE_INTEGER Size;
+	if (!GetFileSizeEx(File, &Size) || (sizeof(void*) < 8 && Size.QuadPart > 0x7FFFFFFF))
+	{
+		// 32-bit process could not map such file
+		CloseHandle(File);
+		appError("File is too large");
+	}
+	MapSize = Size.QuadPart;
+	if (!MapSize)
+	{
+		CloseHandle(File);
+		MapData = EmptyFileData;
+		SetWindow(0);
+		return true;
+	}
+	HANDLE Mapping = CreateFileMapping(File, NULL, PAGE_READONLY, 0, 0, NULL);
+	CloseHandle(File);					// mapping holds a reference to file
+	if (!Mapping)
+		return false;
+	MapData = (const byte*)MapViewOfFile(Mapping, FILE_MAP_READ, 0, 0, 0);
+	if (!MapData)
+	{
+		CloseHandle(Mapping);
+		return false;
+	}
+	Handle = Mapping;
+#else
+	int File = open(Filename, O_RDONLY);
+	if (File < 0)
+		return false;
+	struct stat st;
+	if (fstat(File, &st) || (sizeof(void*) < 8 && st.st_size > 0x7FFFFFFF))
+	{
+		// 32-bit process could not map such file
+		close(File);
+		appError("File is too large");
+	}
+	MapSize = st.st_size;
+	if (!MapSize)
+	{
+		close(File);
+		MapData = EmptyFileData;
+		SetWindow(0);
+		return true;
+	}
+	void *Ptr = mmap(NULL, MapSize, PROT_READ, MAP_PRIVATE, File, 0);
+	close(File);						// mapping holds a reference to file
+	if (Ptr == MAP_FAILED)
+		return false;
+	madvise(Ptr, MapSize, MADV_SEQUENTIAL);
+	MapData = (const byte*)Ptr;
+#endif
+	SetWindow(0);
+	return true;
+
+	unguardf(("%s", Filename));
+}
+
+
+void CMappedFile::Close()
+{
+	if (MapData && MapData != EmptyFileData)
+	{
+#if _WIN32
+		UnmapViewOfFile(MapData);
+		CloseHandle((HANDLE)Handle);
+#else
+		munmap((void*)MapData, MapSize);
+#endif
+	}
+	Data      = MapData = NULL;
+	DataSize  = 0;
+	MapSize   = WindowPos = 0;
+	Handle    = NULL;
+	SetupBuffer(NULL, NULL);
+}
+
+
+void CMappedFile::SetWindow(qword Pos)
+{
+	WindowPos = Pos;
+	Data      = MapData + Pos;
+	DataSize  = (int)min(MapSize - Pos, (qword)0x7FFFFFFF);
+	Seek(0);
+}
+
+
+bool CMappedFile::MoveWindow()
+{
+	// window covers the end of file, or reading is limited with stopper
+	if (WindowPos + DataSize >= MapSize || ArStopper > 0 || !ArPos)
+		return false;
+	SetWindow(WindowPos + ArPos);
+	return true;
+}
+
+
+const void* CMappedFile::View(size_t size)
+{
+	if (size > (size_t)(BufEnd - BufPtr))
+	{
+		MoveWindow();
+		if (size > (size_t)(BufEnd - BufPtr))
+		{
+			if (size <= 0x7FFFFFFF)
+				CheckRange(size);
+			// request is larger than window: return data in place, window will
+			// start after it
+			if (ArStopper > 0 || WindowPos + ArPos + size > MapSize)
+				appError("Serializing behind end of file");
+			const void *Ptr = BufPtr;
+			SetWindow(WindowPos + ArPos + size);
+			return Ptr;
+		}
+	}
+	const void *Ptr = BufPtr;
+	BufPtr += size;
+	ArPos  += size;
+	return Ptr;
+}
+
+
+void CMappedFile::SerializeSlow(void *data, int size)
+{
+	if (MoveWindow() && size <= BufEnd - BufPtr)
+	{
+		memcpy(data, BufPtr, size);
+		BufPtr += size;
+		ArPos  += size;
+		return;
+	}
+	CheckRange(size);
+	// should not get here
+	appError("CMappedFile: bad request of %d bytes at %d", size, ArPos);
+}
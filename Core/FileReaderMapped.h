@@ -0,0 +1,113 @@
+#ifndef __FILEREADERMAPPED_H__
+#define __FILEREADERMAPPED_H__
+
+
+/**
+ * Read-only archive, which maps whole file into memory. Whole mapping is used as
+ * CArchive buffer, so reads are served inline, and data may be accessed in place with
+ * View().
+ * Archive positions are 32-bit, so for files larger than 2Gb archive works with a
+ * window of the mapping: positions are relative to the window start, and window is
+ * moved forward, when sequential reading or View() reaches its end. Such files could
+ * be read sequentially only; Seek() works inside the current window.
+ */
+class CMappedFile : public CArchive
+{
+public:
+	CMappedFile()
+	:	Data(NULL)
+	,	DataSize(0)
+	,	MapData(NULL)
+	,	MapSize(0)
+	,	WindowPos(0)
+	,	Handle(NULL)
+	{
+		IsLoading = true;
+	}
+
+	CMappedFile(const char *Filename)
+	:	Data(NULL)
+	,	DataSize(0)
+	,	MapData(NULL)
+	,	MapSize(0)
+	,	WindowPos(0)
+	,	Handle(NULL)
+	{
+		guard(CMappedFile::CMappedFile);
+		IsLoading = true;
+		if (!Open(Filename))
+			appError("Unable to open file \"%s\"", Filename);
+		unguardf(("%s", Filename));
+	}
+
+	virtual ~CMappedFile()
+	{
+		Close();
+	}
+
+	/**
+	 * Map file into memory. Returns false when file cannot be opened.
+	 */
+	bool Open(const char *Filename);
+	void Close();
+
+	bool IsOpen() const
+	{
+		return MapData != NULL;
+	}
+
+	qword GetFileSize() const
+	{
+		return MapSize;
+	}
+
+	virtual void Seek(int Pos)
+	{
+		if (Pos < 0 || Pos > DataSize)
+			appError("Seeking behind end of file: %d", Pos);
+		ArPos = Pos;
+		// whole window is a serialization buffer
+		SetupBuffer((byte*)Data + Pos, (byte*)Data + DataSize);
+	}
+
+	virtual bool IsEof()
+	{
+		return WindowPos + ArPos >= MapSize;
+	}
+
+	// positions are relative to the window, so only window data could be reached
+	virtual int GetEndPos()
+	{
+		return DataSize;
+	}
+
+	virtual const void* View(size_t size);
+
+protected:
+	const byte	*Data;				// current window
+	int			DataSize;
+	const byte	*MapData;			// whole file
+	qword		MapSize;
+	qword		WindowPos;			// file position of Data
+	void		*Handle;			// platform-specific mapping handle
+
+	// start window at file position Pos
+	void SetWindow(qword Pos);
+	// move window to current position, when file has data behind the window end;
+	// returns false when window was not changed
+	bool MoveWindow();
+
+	FORCEINLINE void CheckRange(int size)
+	{
+		if (ArPos + size > DataSize || size < 0)
+			appError("Serializing behind end of file");
+		if (ArStopper > 0 && ArPos + size > ArStopper)
+			appError("Serializing behind stopper");
+	}
+
+	// called only when request does not fit mapped data
+	virtual void SerializeSlow(void *data, int size);
+};
+
+
+#endif // __FILEREADERMAPPED_H__
@@ -0,0 +1,139 @@
+#ifndef __FILEREADERMEM_H__
+#define __FILEREADERMEM_H__
+
+
+/**
+ * Archive, which holds data in memory. When saving, memory block grows as needed;
+ * when loading, data is used in place (not copied). 'BasePos' is archive position
+ * of the first byte of memory block: this allows to serialize a part of file in
+ * memory while keeping file positions.
+ */
+class CArchiveMem : public CArchive
+{
+public:
+	// create archive for saving
+	CArchiveMem(int InBasePos = 0)
+	:	Data(NULL)
+	,	DataSize(0)
+	,	MaxSize(0)
+	,	BasePos(InBasePos)
+	,	Owned(true)
+	{
+		IsLoading = false;
+		ArPos     = BasePos;
+	}
+
+	// create archive for loading from memory block
+	CArchiveMem(const void *InData, int Size, int InBasePos = 0)
+	:	Data((byte*)InData)
+	,	DataSize(Size)
+	,	MaxSize(Size)
+	,	BasePos(InBasePos)
+	,	Owned(false)
+	{
+		IsLoading = true;
+		Seek(BasePos);
+	}
+
+	virtual ~CArchiveMem()
+	{
+		if (Owned && Data) appFree(Data);
+	}
+
+	const byte* GetData() const
+	{
+		return Data;
+	}
+
+	int GetDataSize()
+	{
+		UpdateSize();
+		return DataSize;
+	}
+
+	virtual void Seek(int Pos)
+	{
+		UpdateSize();
+		if (Pos < BasePos || Pos > BasePos + DataSize)
+			appError("Seeking behind end of data: %d", Pos);
+		ArPos = Pos;
+		SetupBuffer(Data + Pos - BasePos, Data + (IsLoading ? DataSize : MaxSize));
+	}
+
+	virtual bool IsEof()
+	{
+		return !IsLoading || ArPos >= BasePos + DataSize;
+	}
+
+	virtual int GetEndPos()
+	{
+		return IsLoading ? BasePos + DataSize : -1;
+	}
+
+	virtual const void* View(size_t size)
+	{
+		if (!IsLoading) return NULL;
+		if (size > (size_t)(BufEnd - BufPtr))
+			CheckRange(size > 0x7FFFFFFF ? -1 : (int)size);
+		const void *Ptr = BufPtr;
+		BufPtr += size;
+		ArPos  += size;
+		return Ptr;
+	}
+
+protected:
+	byte		*Data;
+	int			DataSize;				// size of valid data
+	int			MaxSize;				// size of allocated block
+	int			BasePos;
+	bool		Owned;
+
+	// account data, written with inline CArchive::Serialize()
+	void UpdateSize()
+	{
+		if (!IsLoading && BufPtr && BufPtr - Data > DataSize)
+			DataSize = BufPtr - Data;
+	}
+
+	void CheckRange(int size)
+	{
+		if (ArPos + size > BasePos + DataSize || size < 0)
+			appError("Serializing behind end of data");
+		if (ArStopper > 0 && ArPos + size > ArStopper)
+			appError("Serializing behind stopper");
+	}
+
+	virtual void SerializeSlow(void *data, int size)
+	{
+		guard(CArchiveMem::Serialize);
+		if (IsLoading)
+		{
+			CheckRange(size);
+			appError("CArchiveMem: bad request of %d bytes at %d", size, ArPos);
+		}
+		if (ArStopper > 0 && ArPos + size > ArStopper)
+			appError("Serializing behind stopper");
+		// grow memory block
+		int Pos     = ArPos - BasePos;
+		int NewSize = max(MaxSize * 2, 4096);
+		while (NewSize < Pos + size)
+			NewSize *= 2;
+		UpdateSize();
+		byte *NewData = (byte*)appMallocNoInit(NewSize);
+		if (Data)
+		{
+			memcpy(NewData, Data, DataSize);
+			appFree(Data);
+		}
+		Data    = NewData;
+		MaxSize = NewSize;
+		memcpy(Data + Pos, data, size);
+		ArPos  += size;
+		SetupBuffer(Data + Pos + size, Data + MaxSize);
+		UpdateSize();
+		unguard;
+	}
+};
+
+
+#endif // __FILEREADERMEM_H__
@@ -7,16 +7,25 @@ class CFile : public CArchive
 public:
 	CFile()
 	:	f(NULL)
+	,	FileSize(-1)
+	,	Buffer(NULL)
+	,	BufCount(0)
 	{}
 
 	CFile(FILE *InFile)
 	:	f(InFile)
+	,	FileSize(-1)
+	,	Buffer(NULL)
+	,	BufCount(0)
 	{
 		IsLoading = true;
 	}
 
 	CFile(const char *Filename, bool loading = true)
 	:	f(fopen(Filename, loading ? "rb" : "wb"))
+	,	FileSize(-1)
+	,	Buffer(NULL)
+	,	BufCount(0)
 	{
 		guard(CFile::CFile);
 		if (!f)
@@ -27,33 +36,77 @@ public:
 
 	virtual ~CFile()
 	{
-		if (f) fclose(f);
+		// cannot report errors from destructor; use Close() to check them
+		if (f)
+		{
+			WriteBuffer();
+			fclose(f);
+		}
+		if (Buffer) appFree(Buffer);
 	}
 
 	void Close()
 	{
-		if (f) fclose(f);
+		guard(CFile::Close);
+		if (!f) return;
+		bool ok = WriteBuffer();
+		fclose(f);
 		f = NULL;
+		SetupBuffer(NULL, NULL);
+		if (!ok)
+			appError("Unable to serialize data");
+		unguard;
 	}
 
 	void Setup(FILE *InFile, bool Loading)
 	{
 		f         = InFile;
 		IsLoading = Loading;
+		FileSize  = -1;
+		ResetBuffer();
+	}
+
+	/**
+	 * Write buffered data to disk. Called automatically by Seek() and Close().
+	 */
+	void Flush()
+	{
+		guard(CFile::Flush);
+		if (!WriteBuffer())
+			appError("Unable to serialize data");
+		unguard;
 	}
 
 	virtual void Seek(int Pos)
 	{
+		guard(CFile::Seek);
+		if (!IsLoading)
+			Flush();
+		ResetBuffer();
 		fseek(f, Pos, SEEK_SET);
 		ArPos = ftell(f);
 		assert(Pos == ArPos);
+		unguard;
 	}
 
 	virtual bool IsEof()
 	{
-		int pos  = ftell(f); fseek(f, 0, SEEK_END);
-		int size = ftell(f); fseek(f, pos, SEEK_SET);
-		return size == pos;
+		if (!IsLoading)
+			return true;
+		return ArPos >= GetEndPos();
+	}
+
+	virtual int GetEndPos()
+	{
+		if (!IsLoading)
+			return -1;
+		if (FileSize < 0)
+		{
+			// file size is not changed when reading, so compute it once
+			int pos  = ftell(f); fseek(f, 0, SEEK_END);
+			FileSize = ftell(f); fseek(f, pos, SEEK_SET);
+		}
+		return FileSize;
 	}
 
 	bool IsOpen()
@@ -62,20 +115,92 @@ public:
 	}
 
 protected:
+	enum { BUFFER_SIZE = 65536 };
+
 	FILE	*f;
-	virtual void Serialize(void *data, int size)
+	int		FileSize;					// cached for GetEndPos(), -1 when not computed yet
+	// When loading, Buffer holds BufCount bytes read from file, BufPtr points to
+	// data at ArPos. When saving, Buffer..BufPtr is data not written to file yet.
+	byte	*Buffer;
+	int		BufCount;
+
+	// drop buffered data (after writing it to disk)
+	void ResetBuffer()
+	{
+		BufCount = 0;
+		if (IsLoading || !Buffer)
+			SetupBuffer(Buffer, Buffer);
+		else
+			SetupBuffer(Buffer, Buffer + BUFFER_SIZE);
+	}
+
+	// returns false on error
+	bool WriteBuffer()
+	{
+		if (IsLoading || !Buffer || BufPtr == Buffer)
+			return true;
+		int size = BufPtr - Buffer;
+		SetupBuffer(Buffer, Buffer + BUFFER_SIZE);
+		return fwrite(Buffer, size, 1, f) == 1;
+	}
+
+	virtual void SerializeSlow(void *data, int size)
 	{
 		guard(CFile::Serialize);
-		int res;
+		if (ArStopper > 0 && ArPos + size > ArStopper)
+			appError("Serializing behind stopper");
+		if (!Buffer)
+		{
+			Buffer = (byte*)appMallocNoInit(BUFFER_SIZE);
+			ResetBuffer();
+		}
 		if (IsLoading)
-			res = fread(data, size, 1, f);
+		{
+			// consume the rest of buffer (BufEnd may be limited with stopper)
+			int avail = BufCount ? Buffer + BufCount - BufPtr : 0;
+			if (avail > 0)
+			{
+				memcpy(data, BufPtr, avail);
+				data   = (byte*)data + avail;
+				size  -= avail;
+				ArPos += avail;
+			}
+			if (size >= BUFFER_SIZE)
+			{
+				// large block: read directly
+				ResetBuffer();
+				int res = fread(data, size, 1, f);
+				ArPos += size;
+				if (res != 1)
+					appError("Unable to serialize data");
+				return;
+			}
+			BufCount = fread(Buffer, 1, BUFFER_SIZE, f);
+			if (BufCount < size)
+			{
+				ResetBuffer();
+				appError("Unable to serialize data");
+			}
+			memcpy(data, Buffer, size);
+			ArPos += size;
+			SetupBuffer(Buffer + size, Buffer + BufCount);
+		}
 		else
-			res = fwrite(data, size, 1, f);
-		ArPos += size;
-		if (ArStopper > 0 && ArPos > ArStopper)
-			appError("Serializing behind stopper");
-		if (res != 1)
-			appError("Unable to serialize data");
+		{
+			Flush();
+			if (size >= BUFFER_SIZE)
+			{
+				// large block: write directly
+				int res = fwrite(data, size, 1, f);
+				ArPos += size;
+				if (res != 1)
+					appError("Unable to serialize data");
+				return;
+			}
+			memcpy(Buffer, data, size);
+			ArPos += size;
+			SetupBuffer(Buffer + size, Buffer + BUFFER_SIZE);
+		}
 		unguard;
 	}
 };
@@ -499,6 +499,7 @@ static int GTexHandle = 128;
 int GL_LoadTexture(const char *name)
 {
 	guard(GL_LoadTexture);
+	MEM_TAG(MEM_GL);
 
 	TString<256> Name;
 	if (GRootDir[0])
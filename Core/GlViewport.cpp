@@ -112,6 +112,7 @@ static GLuint	FontTexNum = 0;
 
 static void LoadFont()
 {
+	MEM_TAG(MEM_GL);
 	// decompress font texture
 	byte *pic = (byte*)appMalloc(TEX_WIDTH * TEX_HEIGHT * 4);
 	int i;
@@ -99,6 +99,8 @@ struct CVec3
 	}
 };
 
+RAW_TYPE(CVec3)
+
 
 inline bool operator==(const CVec3 &v1, const CVec3 &v2)
 {
@@ -244,6 +246,8 @@ struct CAxis
 	}
 };
 
+RAW_TYPE(CAxis)
+
 
 struct CCoords
 {
@@ -268,6 +272,8 @@ struct CCoords
 	}
 };
 
+RAW_TYPE(CCoords)
+
 // Functions for work with coordinate systems, not combined into CCoords class
 
 // global coordinate system -> local coordinate system (src -> dst) by origin/axis coords
@@ -344,6 +350,8 @@ struct CQuat
 	}
 };
 
+RAW_TYPE(CQuat)
+
 void Slerp(const CQuat &A, const CQuat &B, float Alpha, CQuat &dst);
 
 
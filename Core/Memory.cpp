@@ -1,4 +1,21 @@
+#if _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <malloc.h>							// _aligned_malloc()
+#include <intrin.h>							// _ReturnAddress()
+#else
+#include <sys/mman.h>
+#endif
+
 #include "Core.h"
+#include "OutputDeviceFile.h"
+
+
+#if _MSC_VER
+#define CALLER_ADDRESS()	_ReturnAddress()
+#else
+#define CALLER_ADDRESS()	__builtin_return_address(0)
+#endif
 
 
 static void OutOfMemory()
@@ -7,33 +24,842 @@ static void OutOfMemory()
 }
 
 
-void *appMalloc(int size)
+/*-----------------------------------------------------------------------------
+	Small block allocator
+	Blocks up to POOL_MAX_SIZE bytes are allocated from size-class pools. Pool
+	memory is a single reserved address range, so appFree() recognizes pool
+	blocks by address, and other blocks are passed to CRT heap. Each thread
+	has own lists of free blocks, which are exchanged with the shared pool as
+	whole batches of PoolBatch[] blocks, so most operations are performed
+	without locking, and the shared pool operations does not walk lists.
+-----------------------------------------------------------------------------*/
+
+#define POOL_PAGE_SHIFT		16						// 64Kb pages, page holds blocks of a single size
+#define POOL_PAGE_SIZE		(1 << POOL_PAGE_SHIFT)
+#define POOL_MAX_SIZE		4096
+#define POOL_MAX_PAGES		65536					// 4Gb of address space
+#define POOL_NUM_CLASSES	28
+
+static const int PoolClassSize[POOL_NUM_CLASSES] =
+{
+	16,   32,   48,   64,   80,   96,   112,  128,
+	160,  192,  224,  256,  320,  384,  448,  512,
+	640,  768,  896,  1024, 1280, 1536, 1792, 2048,
+	2560, 3072, 3584, 4096
+};
+
+// free blocks are linked with the first pointer; first block of batch has link
+// to the next batch in the second pointer
+#define NEXT_BLOCK(Block)	(((void**)(Block))[0])
+#define NEXT_BATCH(Block)	(((void**)(Block))[1])
+
+struct CPoolCache
+{
+	void		*Head;							// list of free blocks
+	int			Count;							// number of blocks in Head list, < PoolBatch
+	void		*Spare;							// full batch or NULL
+};
+
+struct CPoolShared
+{
+	void		*Batches;						// list of full batches
+	void		*Loose;							// blocks, released by finished threads
+	int			NumLoose;
+};
+
+static byte			PoolSizeToClass[POOL_MAX_SIZE / 16 + 1];
+static int			PoolBatch[POOL_NUM_CLASSES];
+static byte			PoolPageClass[POOL_MAX_PAGES];
+static byte			*PoolBase;
+static byte			*PoolTop;
+static size_t		PoolSize;					// size of reserved address range
+static bool			PoolInitialized;
+static CPoolShared	PoolShared[POOL_NUM_CLASSES];
+static volatile int	PoolLock;
+
+static THREAD_LOCAL CPoolCache PoolCache[POOL_NUM_CLASSES];
+
+
+static FORCEINLINE void LockPool()
+{
+	while (appInterlockedExchange(&PoolLock, 1))
+	{
+		// spin, lock is held for a short time
+	}
+}
+
+static FORCEINLINE void UnlockPool()
+{
+	appInterlockedExchange(&PoolLock, 0);
+}
+
+
+static FORCEINLINE bool IsPoolBlock(const void *ptr)
+{
+	return (size_t)ptr - (size_t)PoolBase < PoolSize;
+}
+
+
+static FORCEINLINE int GetBlockClass(const void *ptr)
+{
+	return PoolPageClass[((byte*)ptr - PoolBase) >> POOL_PAGE_SHIFT];
+}
+
+
+// called under lock
+static void InitPool()
+{
+	int i, cls;
+	for (i = 0, cls = 0; i <= POOL_MAX_SIZE / 16; i++)
+	{
+		if (i * 16 > PoolClassSize[cls]) cls++;
+		PoolSizeToClass[i] = cls;
+	}
+	for (cls = 0; cls < POOL_NUM_CLASSES; cls++)
+		PoolBatch[cls] = bound(POOL_PAGE_SIZE / PoolClassSize[cls] / 4, 4, 64);
+	// reserve address space; smaller range is used when system could not reserve
+	// the whole range; pool is not used when nothing could be reserved
+	size_t MaxSize = (size_t)POOL_PAGE_SIZE * ((sizeof(void*) > 4) ? POOL_MAX_PAGES : POOL_MAX_PAGES / 4);
+	for (size_t Size = MaxSize; Size >= 64 << 20; Size >>= 1)
+	{
+#if _WIN32
+		void *Mem = VirtualAlloc(NULL, Size, MEM_RESERVE, PAGE_READWRITE);
+#else
+		void *Mem = mmap(NULL, Size, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS|MAP_NORESERVE, -1, 0);
+		if (Mem == MAP_FAILED) Mem = NULL;
+#endif
+		if (!Mem) continue;
+		// align to page size; reserved memory is already aligned on Windows
+		PoolBase = (byte*)(((size_t)Mem + POOL_PAGE_SIZE - 1) & ~(size_t)(POOL_PAGE_SIZE - 1));
+		PoolTop  = PoolBase;
+		PoolSize = Size - (PoolBase - (byte*)Mem);
+		break;
+	}
+	PoolInitialized = true;
+}
+
+
+// called under lock; places blocks of the new page into thread cache and
+// shared pool, returns false when failed
+static bool AllocPoolPage(int cls)
+{
+	if ((size_t)(PoolTop - PoolBase) + POOL_PAGE_SIZE > PoolSize)
+		return false;							// address space is exhausted
+	byte *Page = PoolTop;
+#if _WIN32
+	if (!VirtualAlloc(Page, POOL_PAGE_SIZE, MEM_COMMIT, PAGE_READWRITE))
+		return false;
+#endif
+	PoolTop += POOL_PAGE_SIZE;
+	PoolPageClass[(Page - PoolBase) >> POOL_PAGE_SHIFT] = cls;
+	// split page to batches; the first (possibly incomplete) batch goes to cache
+	int BlockSize = PoolClassSize[cls];
+	int Batch     = PoolBatch[cls];
+	int Count     = POOL_PAGE_SIZE / BlockSize;
+	int First     = Count % Batch;
+	if (!First) First = Batch;
+	CPoolShared &Shared = PoolShared[cls];
+	byte *Block = Page;
+	for (int i = 0; i < Count; i++, Block += BlockSize)
+	{
+		int BatchIndex = (i < First) ? i : (i - First) % Batch;
+		int BatchSize  = (i < First) ? First : Batch;
+		NEXT_BLOCK(Block) = (BatchIndex < BatchSize - 1) ? Block + BlockSize : NULL;
+		if (BatchIndex == 0 && i >= First)
+		{
+			NEXT_BATCH(Block) = Shared.Batches;
+			Shared.Batches    = Block;
+		}
+	}
+	CPoolCache &Cache = PoolCache[cls];
+	Cache.Head  = Page;
+	Cache.Count = First;
+	return true;
+}
+
+
+static void* PoolRefill(int cls)
+{
+	CPoolCache &Cache = PoolCache[cls];
+	// use spare batch
+	if (Cache.Spare)
+	{
+		Cache.Head  = Cache.Spare;
+		Cache.Count = PoolBatch[cls];
+		Cache.Spare = NULL;
+		return Cache.Head;
+	}
+	LockPool();
+	CPoolShared &Shared = PoolShared[cls];
+	if (Shared.Batches)
+	{
+		// take a whole batch
+		Cache.Head     = Shared.Batches;
+		Cache.Count    = PoolBatch[cls];
+		Shared.Batches = NEXT_BATCH(Cache.Head);
+	}
+	else if (Shared.Loose)
+	{
+		// take blocks of finished threads
+		int Count = min(Shared.NumLoose, PoolBatch[cls] - 1);
+		void *Tail = Shared.Loose;
+		for (int i = 1; i < Count; i++)
+			Tail = NEXT_BLOCK(Tail);
+		Cache.Head       = Shared.Loose;
+		Cache.Count      = Count;
+		Shared.Loose     = NEXT_BLOCK(Tail);
+		Shared.NumLoose -= Count;
+		NEXT_BLOCK(Tail) = NULL;
+	}
+	else if (!AllocPoolPage(cls))
+	{
+		Cache.Head = NULL;
+	}
+	UnlockPool();
+	return Cache.Head;
+}
+
+
+static FORCEINLINE int GetPoolClass(int size, int alignment)
+{
+	int cls = PoolSizeToClass[(size + 15) >> 4];
+	// all blocks are aligned to 16 bytes; for larger alignment use a class with block
+	// size, which is a multiple of alignment: pages are aligned to POOL_PAGE_SIZE, so
+	// all blocks of such class are aligned
+	if (alignment > 16)
+	{
+		while (PoolClassSize[cls] & (alignment - 1))
+			cls++;
+	}
+	return cls;
+}
+
+
+static FORCEINLINE void* PoolAlloc(int size, int alignment)
+{
+	int cls = GetPoolClass(size, alignment);
+	CPoolCache &Cache = PoolCache[cls];
+	void *Block = Cache.Head;
+	if (!Block)
+	{
+		if (!PoolInitialized)
+		{
+			// class table is not built yet
+			LockPool();
+			if (!PoolInitialized)
+				InitPool();
+			UnlockPool();
+			cls = GetPoolClass(size, alignment);
+		}
+		if (!PoolSize) return NULL;				// address space was not reserved
+		Block = PoolRefill(cls);
+		if (!Block) return NULL;				// use CRT heap
+	}
+	CPoolCache &Cache2 = PoolCache[cls];
+	Cache2.Head = NEXT_BLOCK(Block);
+	Cache2.Count--;
+	return Block;
+}
+
+
+static FORCEINLINE void PoolFree(void *ptr)
+{
+	int cls = GetBlockClass(ptr);
+	CPoolCache &Cache = PoolCache[cls];
+	NEXT_BLOCK(ptr) = Cache.Head;
+	Cache.Head = ptr;
+	if (++Cache.Count < PoolBatch[cls])
+		return;
+	// the list became a full batch: keep it as spare, return previous spare
+	// batch to the shared pool
+	if (Cache.Spare)
+	{
+		LockPool();
+		CPoolShared &Shared = PoolShared[cls];
+		NEXT_BATCH(Cache.Spare) = Shared.Batches;
+		Shared.Batches = Cache.Spare;
+		UnlockPool();
+	}
+	Cache.Spare = Cache.Head;
+	Cache.Head  = NULL;
+	Cache.Count = 0;
+}
+
+
+static void ReleaseScratch();
+
+void appReleaseThreadCache()
+{
+	ReleaseScratch();
+	LockPool();
+	for (int cls = 0; cls < POOL_NUM_CLASSES; cls++)
+	{
+		CPoolCache &Cache = PoolCache[cls];
+		CPoolShared &Shared = PoolShared[cls];
+		if (Cache.Spare)
+		{
+			NEXT_BATCH(Cache.Spare) = Shared.Batches;
+			Shared.Batches = Cache.Spare;
+		}
+		if (Cache.Count)
+		{
+			void *Tail = Cache.Head;
+			while (NEXT_BLOCK(Tail))
+				Tail = NEXT_BLOCK(Tail);
+			NEXT_BLOCK(Tail) = Shared.Loose;
+			Shared.Loose     = Cache.Head;
+			Shared.NumLoose += Cache.Count;
+		}
+		Cache.Head  = Cache.Spare = NULL;
+		Cache.Count = 0;
+	}
+	UnlockPool();
+}
+
+
+/*-----------------------------------------------------------------------------
+	Memory allocation functions
+-----------------------------------------------------------------------------*/
+
+/*
+ * CRT heap is used for large blocks. Blocks are aligned to MALLOC_ALIGNMENT or
+ * more; on Windows all of them are allocated with _aligned_malloc(), because
+ * such blocks should be released with _aligned_free().
+ */
+
+#if _WIN32
+
+static FORCEINLINE void *CrtAlloc(int size, int alignment)
+{
+	return _aligned_malloc(max(size, 1), alignment);
+}
+
+static FORCEINLINE void *CrtRealloc(void *ptr, int size, int alignment)
+{
+	return _aligned_realloc(ptr, max(size, 1), alignment);
+}
+
+static FORCEINLINE void CrtFree(void *ptr)
+{
+	_aligned_free(ptr);
+}
+
+#else // _WIN32
+
+#define CRT_ALIGNMENT		(int)(2 * sizeof(void*))	// alignment of malloc() blocks
+
+static FORCEINLINE void *CrtAlloc(int size, int alignment)
+{
+	if (alignment <= CRT_ALIGNMENT)
+		return malloc(size);
+	void *data;
+	if (posix_memalign(&data, alignment, max(size, 1)))
+		return NULL;
+	return data;
+}
+
+static FORCEINLINE void *CrtRealloc(void *ptr, int size, int alignment)
+{
+	void *data = realloc(ptr, size);
+	if (data && !IsAligned(data, alignment))
+	{
+		// realloc() does not preserve alignment, move data again
+		void *aligned = CrtAlloc(size, alignment);
+		if (aligned)
+			memcpy(aligned, data, size);
+		free(data);
+		data = aligned;
+	}
+	return data;
+}
+
+static FORCEINLINE void CrtFree(void *ptr)
+{
+	free(ptr);
+}
+
+#endif // _WIN32
+
+
+static FORCEINLINE void *RawMallocNoInit(int size, int alignment)
 {
 	assert(size >= 0);
-	void *data = malloc(size);
+	void *data = (size <= POOL_MAX_SIZE) ? PoolAlloc(size, alignment) : NULL;
 	if (!data)
-		OutOfMemory();
-	if (size > 0)
+	{
+		data = CrtAlloc(size, alignment);
+		if (!data)
+			OutOfMemory();
+	}
+	return data;
+}
+
+
+static FORCEINLINE void *RawMalloc(int size, int alignment)
+{
+	assert(size >= 0);
+	void *data = (size <= POOL_MAX_SIZE) ? PoolAlloc(size, alignment) : NULL;
+	if (data)
+	{
 		memset(data, 0, size);
+		return data;
+	}
+#if !_WIN32
+	// large blocks: calloc() could use memory, which is already filled with zeros
+	if (alignment <= CRT_ALIGNMENT)
+	{
+		data = calloc(max(size, 1), 1);
+		if (!data)
+			OutOfMemory();
+		return data;
+	}
+#endif
+	data = CrtAlloc(size, alignment);
+	if (!data)
+		OutOfMemory();
+	memset(data, 0, size);
 	return data;
 }
 
 
-void *appRealloc(void *ptr, int size)
+static FORCEINLINE void *RawRealloc(void *ptr, int size, int alignment)
 {
 	assert(size >= 0);
-	void *data = realloc(ptr, size);
+	if (IsPoolBlock(ptr))
+	{
+		int OldSize = PoolClassSize[GetBlockClass(ptr)];
+		if (size <= OldSize)
+			return ptr;							// block is large enough
+		void *data = RawMallocNoInit(size, alignment);
+		memcpy(data, ptr, OldSize);
+		PoolFree(ptr);
+		return data;
+	}
+	if (!ptr)
+		return RawMallocNoInit(size, alignment);
+	void *data = CrtRealloc(ptr, size, alignment);
 	if (!data)
 		OutOfMemory();
 	return data;
 }
 
 
+static FORCEINLINE void RawFree(void *ptr)
+{
+	if (IsPoolBlock(ptr))
+		PoolFree(ptr);
+	else if (ptr)
+		CrtFree(ptr);
+}
+
+
+#if !MEM_STATS
+
+void *appMallocNoInit(int size, int alignment)
+{
+	return RawMallocNoInit(size, alignment);
+}
+
+
+void *appMalloc(int size, int alignment)
+{
+	return RawMalloc(size, alignment);
+}
+
+
+void *appRealloc(void *ptr, int size, int alignment)
+{
+	return RawRealloc(ptr, size, alignment);
+}
+
+
+void appFree(void *ptr)
+{
+	RawFree(ptr);
+}
+
+
+void appDumpMemoryStats(COutputDevice *Out)
+{
+	Out->Printf("Memory statistics are disabled, build with MEM_STATS=1\n");
+}
+
+
+int appMemoryFrame()
+{
+	return 0;
+}
+
+#else // MEM_STATS
+
+/*-----------------------------------------------------------------------------
+	Allocation statistics
+	Each block is prefixed with CMemHeader; header is placed immediately before
+	data, and data is offset by a multiple of block alignment (16 bytes or more)
+	from the start of allocated memory. Counters are updated with interlocked
+	operations; peak values are updated without locking, so they may miss a
+	concurrent update, this is acceptable for statistics. Live blocks are linked
+	into a list, which is used for leak report at exit.
+-----------------------------------------------------------------------------*/
+
+#define MEM_MAGIC			0x4D454D41		// 'MEMA'
+#define MEM_LEAKS_FILE		"memory.log"
+#define MEM_MAX_LEAKS		4096			// limit of blocks, listed in leak report
+#define MEM_LEAK_BYTES		16				// number of block bytes, shown in leak report
+
+struct CMemHeader
+{
+	CMemHeader	*Prev;							// list of live blocks
+	CMemHeader	*Next;
+	void		*Caller;						// return address of allocation function
+	int			Size;
+	int			Tag;
+	int			Magic;
+	int			Offset;							// offset of data from allocated memory
+};
+
+struct CMemTagStats
+{
+	volatile int	Blocks;
+	volatile int	Bytes;
+	int				PeakBlocks;
+	int				PeakBytes;
+	volatile int	NumAllocs;					// allocations since start
+};
+
+static const char *MemTagNames[MEM_NUM_TAGS] =
+{
+	"Default", "Mesh", "Anim", "Typeinfo", "GL", "Editor"
+};
+
+THREAD_LOCAL int	GMemTag;
+
+static CMemTagStats	MemStats[MEM_NUM_TAGS];
+static volatile int	MemTotalBytes;
+static int			MemPeakBytes;
+static volatile int	MemFrameAllocs;
+static CMemHeader	*MemBlocks;					// most recently allocated block
+static volatile int	MemBlocksLock;
+
+
+static FORCEINLINE void LockBlocks()
+{
+	while (appInterlockedExchange(&MemBlocksLock, 1))
+	{
+		// spin, lock is held for a short time
+	}
+}
+
+static FORCEINLINE void UnlockBlocks()
+{
+	appInterlockedExchange(&MemBlocksLock, 0);
+}
+
+
+static FORCEINLINE void UpdatePeak(int &Peak, int Value)
+{
+	if (Value > Peak) Peak = Value;
+}
+
+
+// alignment of allocated memory; data alignment is kept, when header is padded
+// to multiple of it
+static FORCEINLINE int GetMemAlignment(int alignment)
+{
+	return max(alignment, MALLOC_ALIGNMENT);
+}
+
+// offset of data from allocated memory: header size rounded up to alignment
+// (not a power of 2, so it should not be used as alignment itself)
+static FORCEINLINE int GetDataOffset(int alignment)
+{
+	return Align(sizeof(CMemHeader), GetMemAlignment(alignment));
+}
+
+
+static FORCEINLINE void *TrackAlloc(void *Mem, int Offset, int Size, int Tag, void *Caller)
+{
+	byte *Data = (byte*)Mem + Offset;
+	CMemHeader *Hdr = (CMemHeader*)Data - 1;
+	Hdr->Caller = Caller;
+	Hdr->Size   = Size;
+	Hdr->Tag    = Tag;
+	Hdr->Magic  = MEM_MAGIC;
+	Hdr->Offset = Offset;
+	Hdr->Prev   = NULL;
+	LockBlocks();
+	Hdr->Next = MemBlocks;
+	if (MemBlocks) MemBlocks->Prev = Hdr;
+	MemBlocks = Hdr;
+	UnlockBlocks();
+	CMemTagStats &S = MemStats[Tag];
+	UpdatePeak(S.PeakBlocks, appInterlockedAdd(&S.Blocks, 1) + 1);
+	UpdatePeak(S.PeakBytes,  appInterlockedAdd(&S.Bytes, Size) + Size);
+	UpdatePeak(MemPeakBytes, appInterlockedAdd(&MemTotalBytes, Size) + Size);
+	appInterlockedAdd(&S.NumAllocs, 1);
+	appInterlockedAdd(&MemFrameAllocs, 1);
+	return Data;
+}
+
+
+static FORCEINLINE CMemHeader *UntrackAlloc(void *ptr)
+{
+	CMemHeader *Hdr = (CMemHeader*)ptr - 1;
+	if (Hdr->Magic != MEM_MAGIC)
+		appError("Freeing wrong memory block %p", ptr);
+	Hdr->Magic = 0;								// detect double free
+	LockBlocks();
+	if (Hdr->Prev)
+		Hdr->Prev->Next = Hdr->Next;
+	else
+		MemBlocks = Hdr->Next;
+	if (Hdr->Next) Hdr->Next->Prev = Hdr->Prev;
+	UnlockBlocks();
+	CMemTagStats &S = MemStats[Hdr->Tag];
+	appInterlockedAdd(&S.Blocks, -1);
+	appInterlockedAdd(&S.Bytes, -Hdr->Size);
+	appInterlockedAdd(&MemTotalBytes, -Hdr->Size);
+	return Hdr;
+}
+
+
+static void *TrackedMalloc(int size, int alignment, bool Init, void *Caller)
+{
+	assert(size >= 0);
+	int Offset = GetDataOffset(alignment);
+	int MemAlign = GetMemAlignment(alignment);
+	void *Mem = Init ? RawMalloc(size + Offset, MemAlign) : RawMallocNoInit(size + Offset, MemAlign);
+	return TrackAlloc(Mem, Offset, size, GMemTag, Caller);
+}
+
+
+void *appMallocNoInit(int size, int alignment)
+{
+	return TrackedMalloc(size, alignment, false, CALLER_ADDRESS());
+}
+
+
+void *appMalloc(int size, int alignment)
+{
+	return TrackedMalloc(size, alignment, true, CALLER_ADDRESS());
+}
+
+
+void *appRealloc(void *ptr, int size, int alignment)
+{
+	assert(size >= 0);
+	if (!ptr)
+		return TrackedMalloc(size, alignment, false, CALLER_ADDRESS());
+	// block keeps its original tag and call site
+	CMemHeader *Hdr = UntrackAlloc(ptr);
+	int Tag      = Hdr->Tag;
+	int Offset   = Hdr->Offset;
+	void *Caller = Hdr->Caller;
+	assert(Offset == GetDataOffset(alignment));
+	void *Mem = RawRealloc((byte*)ptr - Offset, size + Offset, GetMemAlignment(alignment));
+	return TrackAlloc(Mem, Offset, size, Tag, Caller);
+}
+
+
 void appFree(void *ptr)
+{
+	if (!ptr) return;
+	CMemHeader *Hdr = UntrackAlloc(ptr);
+	RawFree((byte*)ptr - Hdr->Offset);
+}
+
+
+void appDumpMemoryStats(COutputDevice *Out)
+{
+	guard(appDumpMemoryStats);
+	Out->Printf("%-10s %10s %12s %10s %12s %10s\n", "Tag", "Blocks", "Bytes", "PeakBlocks", "PeakBytes", "Allocs");
+	int TotalBlocks = 0, TotalAllocs = 0;
+	for (int i = 0; i < MEM_NUM_TAGS; i++)
+	{
+		const CMemTagStats &S = MemStats[i];
+		Out->Printf("%-10s %10d %12d %10d %12d %10d\n", MemTagNames[i],
+			S.Blocks, S.Bytes, S.PeakBlocks, S.PeakBytes, S.NumAllocs);
+		TotalBlocks += S.Blocks;
+		TotalAllocs += S.NumAllocs;
+	}
+	Out->Printf("%-10s %10d %12d %10s %12d %10d\n", "Total", TotalBlocks, MemTotalBytes, "", MemPeakBytes, TotalAllocs);
+	unguard;
+}
+
+
+int appMemoryFrame()
+{
+	return appInterlockedExchange(&MemFrameAllocs, 0);
+}
+
+
+// write blocks, which are still allocated at exit, to a file: log window and
+// other output devices are already destroyed at this time. Call site is a code
+// address, it may be resolved with debugger or addr2line. Lines are formatted
+// and written without Printf(), which locks the log: block list is locked here,
+// and allocations are not allowed.
+static void DumpLeaks()
+{
+	COutputDeviceFile Out(MEM_LEAKS_FILE, true);
+	Out.Printf("Blocks allocated at exit:\n");
+	appDumpMemoryStats(&Out);
+	Out.Printf("\n%-10s %10s %18s  %s\n", "Tag", "Size", "Caller", "Data");
+
+	char Line[256];
+	int NumBlocks = 0;
+	LockBlocks();
+	for (const CMemHeader *Hdr = MemBlocks; Hdr; Hdr = Hdr->Next, NumBlocks++)
+	{
+		if (NumBlocks >= MEM_MAX_LEAKS) continue;	// count remaining blocks
+		const byte *Data = (const byte*)(Hdr + 1);
+		int NumBytes = min(Hdr->Size, MEM_LEAK_BYTES);
+		char Hex[MEM_LEAK_BYTES * 3 + 1], Text[MEM_LEAK_BYTES + 1];
+		for (int i = 0; i < NumBytes; i++)
+		{
+			appSprintf(Hex + i * 3, 4, "%02X ", Data[i]);
+			Text[i] = (Data[i] >= ' ' && Data[i] < 127) ? Data[i] : '.';
+		}
+		Hex[NumBytes * 3] = 0;
+		Text[NumBytes]    = 0;
+		appSprintf(ARRAY_ARG(Line), "%-10s %10d %18p  %-*s %s\n", MemTagNames[Hdr->Tag],
+			Hdr->Size, Hdr->Caller, MEM_LEAK_BYTES * 3, Hex, Text);
+		Out.Write(Line);
+	}
+	UnlockBlocks();
+	if (NumBlocks > MEM_MAX_LEAKS)
+		Out.Printf("... and %d more blocks\n", NumBlocks - MEM_MAX_LEAKS);
+}
+
+static struct CMemLeakReport
+{
+	CMemLeakReport()
+	{
+		atexit(DumpLeaks);
+	}
+} MemLeakReport;
+
+#endif // MEM_STATS
+
+
+/*-----------------------------------------------------------------------------
+	Global operator new/delete
+	Replacement functions are defined out of line in this single module, so
+	the linker uses them for the whole process: objects, which are created by
+	our code and destroyed by wxWidgets or C++ runtime (or vice versa), are
+	using the same allocator. Replacement is not visible to DLLs on Windows,
+	so operators are using CRT heap there. RETAIL build (runtime library) does
+	not replace operators at all: game may have own allocator, library classes
+	are using DECLARE_ALLOCATOR.
+-----------------------------------------------------------------------------*/
+
+#ifndef RETAIL
+
+#if _WIN32
+
+static FORCEINLINE void *NewAlloc(size_t size, void *Caller)
+{
+	void *data = calloc(max(size, (size_t)1), 1);
+	if (!data)
+		OutOfMemory();
+	return data;
+}
+
+static FORCEINLINE void NewFree(void *ptr)
 {
 	free(ptr);
 }
 
+#else // _WIN32
+
+static FORCEINLINE void *NewAlloc(size_t size, void *Caller)
+{
+	if (size > 0x7FFFFFFF)
+		OutOfMemory();
+#if MEM_STATS
+	// attribute block to the code, which is using 'new'
+	return TrackedMalloc((int)size, MALLOC_ALIGNMENT, true, Caller);
+#else
+	return appMalloc((int)size);
+#endif
+}
+
+static FORCEINLINE void NewFree(void *ptr)
+{
+	appFree(ptr);
+}
+
+#endif // _WIN32
+
+
+void *operator new(size_t size)
+{
+	return NewAlloc(size, CALLER_ADDRESS());
+}
+
+void *operator new[](size_t size)
+{
+	return NewAlloc(size, CALLER_ADDRESS());
+}
+
+void operator delete(void *ptr) throw()
+{
+	NewFree(ptr);
+}
+
+void operator delete[](void *ptr) throw()
+{
+	NewFree(ptr);
+}
+
+// sized deallocation functions, used by C++14 compilers
+void operator delete(void *ptr, size_t size) throw()
+{
+	NewFree(ptr);
+}
+
+void operator delete[](void *ptr, size_t size) throw()
+{
+	NewFree(ptr);
+}
+
+// nothrow versions: some C++ runtimes implement them with malloc() instead of
+// calling replaceable operator new
+void *operator new(size_t size, const std::nothrow_t&) throw()
+{
+	try
+	{
+		return NewAlloc(size, CALLER_ADDRESS());
+	}
+	catch (...)
+	{
+		return NULL;
+	}
+}
+
+void *operator new[](size_t size, const std::nothrow_t&) throw()
+{
+	try
+	{
+		return NewAlloc(size, CALLER_ADDRESS());
+	}
+	catch (...)
+	{
+		return NULL;
+	}
+}
+
+void operator delete(void *ptr, const std::nothrow_t&) throw()
+{
+	NewFree(ptr);
+}
+
+void operator delete[](void *ptr, const std::nothrow_t&) throw()
+{
+	NewFree(ptr);
+}
+
+#endif // !RETAIL
+
 
 /*-----------------------------------------------------------------------------
 	Memory chain
@@ -43,9 +869,7 @@ void* CMemoryChain::operator new(size_t size, int dataSize)
 {
 	guardSlow(CMemoryChain::new);
 	int alloc = Align(size + dataSize, MEM_CHUNK_SIZE);
-	CMemoryChain *chain = (CMemoryChain *) malloc(alloc);
-	if (!chain)
-		OutOfMemory();
+	CMemoryChain *chain = (CMemoryChain *) appMallocNoInit(alloc);
 	chain->size = alloc;
 	chain->next = NULL;
 	chain->data = (byte*) OffsetPointer(chain, size);
@@ -66,7 +890,7 @@ void CMemoryChain::operator delete(void *ptr)
 	{
 		// free memory block
 		next = curr->next;
-		free(curr);
+		appFree(curr);
 	}
 	unguardSlow;
 }
@@ -106,3 +930,117 @@ int CMemoryChain::GetSize() const
 		n += c->size;
 	return n;
 }
+
+
+/*-----------------------------------------------------------------------------
+	Scratch memory
+	Thread has a list of chunks; chunks after the current one are not used, and
+	are kept for the following allocations. Chunks, which are larger than
+	SCRATCH_CHUNK_SIZE, were allocated for a single large block, they are freed
+	on rewind.
+-----------------------------------------------------------------------------*/
+
+#define SCRATCH_CHUNK_SIZE	(256*1024)
+
+struct CScratchChunk
+{
+	CScratchChunk	*Next;
+	byte			*End;
+	int				Size;
+};
+
+struct CScratchArena
+{
+	CScratchChunk	*First;
+	CScratchChunk	*Chunk;						// current chunk, NULL when nothing allocated
+	byte			*Top;						// free space in current chunk
+};
+
+static THREAD_LOCAL CScratchArena Scratch;
+
+
+static void *ScratchAllocSlow(int size, int alignment)
+{
+	guard(ScratchAllocSlow);
+	CScratchChunk *Prev = Scratch.Chunk;
+	CScratchChunk *Next = Prev ? Prev->Next : Scratch.First;
+	// use the next chunk, when it is large enough, otherwise insert a new one
+	if (!Next || Align((byte*)(Next + 1), alignment) + size > Next->End)
+	{
+		int alloc = max(SCRATCH_CHUNK_SIZE, (int)sizeof(CScratchChunk) + size + alignment);
+		CScratchChunk *C = (CScratchChunk*)appMallocNoInit(alloc);
+		C->Next = Next;
+		C->End  = (byte*)C + alloc;
+		C->Size = alloc;
+		if (Prev)
+			Prev->Next = C;
+		else
+			Scratch.First = C;
+		Next = C;
+	}
+	Scratch.Chunk = Next;
+	byte *start = Align((byte*)(Next + 1), alignment);
+	Scratch.Top = start + size;
+	return start;
+	unguard;
+}
+
+
+void *appScratchAlloc(int size, int alignment)
+{
+	assert(size >= 0);
+	if (Scratch.Chunk)
+	{
+		byte *start = Align(Scratch.Top, alignment);
+		if (start + size <= Scratch.Chunk->End)
+		{
+			Scratch.Top = start + size;
+			return start;
+		}
+	}
+	return ScratchAllocSlow(size, alignment);
+}
+
+
+CScratchMark appScratchMark()
+{
+	CScratchMark Mark;
+	Mark.Chunk = Scratch.Chunk;
+	Mark.Top   = Scratch.Top;
+	return Mark;
+}
+
+
+void appScratchRewind(const CScratchMark &Mark)
+{
+	CScratchChunk *C = (CScratchChunk*)Mark.Chunk;
+	Scratch.Chunk = C;
+	Scratch.Top   = Mark.Top;
+	// free oversized chunks, which are not used anymore
+	CScratchChunk **Link = C ? &C->Next : &Scratch.First;
+	while (CScratchChunk *Next = *Link)
+	{
+		if (Next->Size > SCRATCH_CHUNK_SIZE)
+		{
+			*Link = Next->Next;
+			appFree(Next);
+		}
+		else
+		{
+			Link = &Next->Next;
+		}
+	}
+}
+
+
+static void ReleaseScratch()
+{
+	CScratchChunk *C, *Next;
+	for (C = Scratch.First; C; C = Next)
+	{
+		Next = C->Next;
+		appFree(C);
+	}
+	Scratch.First = Scratch.Chunk = NULL;
+	Scratch.Top   = NULL;
+}
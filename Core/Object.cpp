@@ -1,8 +1,7 @@
 #include "Core.h"
-#include "FileReaderStdio.h"			// for CObject::InternalLoad()
-
-
-#define MAX_CLASS_NAME		256
+#include "FileReaderMapped.h"			// for CObject::InternalLoad()
+#include "FileReaderMem.h"
+#include "FileReaderStdio.h"			// for SaveObjectFile()
 
 
 /*-----------------------------------------------------------------------------
@@ -19,7 +18,14 @@ void CObject::Serialize(CArchive &Ar)
 {
 	/* Streamed class layout:
 	 *	string		ClassName
-	 *	byte		PropCount	(reserved!!)
+	 *	byte		HasProps
+	 *	{							(when HasProps != 0, ArVer >= 8)
+	 *		unsigned	LayoutHash	CStruct::GetLayoutHash() of the class
+	 *		int			PropsEnd	position after property data
+	 *		int			DirPos		position of field directory (ArVer >= 9)
+	 *		...						non-native properties, CStruct::SerializeProps()
+	 *		...						field directory, CStruct::SaveFields() (ArVer >= 9)
+	 *	}
 	 */
 	//?? TODO: move ClassName serialization outside
 	TString<MAX_CLASS_NAME> ClassName;
@@ -38,10 +44,56 @@ void CObject::Serialize(CArchive &Ar)
 		// store object header
 		Ar << ClassName;
 	}
-	//!! reserved place for props
-	byte tmp = 0;
-	Ar << tmp;
-	assert(tmp == 0);
+	// properties, serialized using typeinfo (available in editor only)
+	const CType *Type = FindType(ClassName, false);
+	const CStruct *Struc = (Type && Type->IsStruc) ? (CStruct*)Type : NULL;
+	byte HasProps = (Struc && Struc->HasSerializedProps()) ? 1 : 0;
+	Ar << HasProps;
+	if (!HasProps) return;
+	if (Ar.IsLoading && Ar.ArVer < 8)
+		appError("Unexpected property data");
+
+	unsigned LayoutHash = Struc ? Struc->GetLayoutHash() : 0;
+	int PropsEnd = 0;
+	int DirPos = 0;
+	int HeaderPos = Ar.Tell();
+	Ar << LayoutHash << PropsEnd;
+	if (Ar.ArVer >= 9) Ar << DirPos;
+	if (Ar.IsLoading)
+	{
+		if (!Struc)
+		{
+			// no typeinfo: skip properties
+			Ar.Seek(PropsEnd);
+			return;
+		}
+		if (LayoutHash != Struc->GetLayoutHash())
+		{
+			if (Ar.ArVer >= 9)
+				Struc->LoadFields(Ar, this, DirPos);
+			else
+				appNotify("%s: properties were changed, keeping default values", *ClassName);
+			Ar.Seek(PropsEnd);
+			return;
+		}
+		Struc->SerializeProps(Ar, this);
+		if (Ar.Tell() != (Ar.ArVer >= 9 ? DirPos : PropsEnd))
+			appError("%s: wrong property data size", *ClassName);
+		Ar.Seek(PropsEnd);
+	}
+	else
+	{
+		if (Ar.ArVer >= 9)
+			DirPos = Struc->SaveFields(Ar, this);
+		else
+			Struc->SerializeProps(Ar, this);
+		// patch end position and directory position
+		PropsEnd = Ar.Tell();
+		Ar.Seek(HeaderPos + sizeof(unsigned));
+		Ar << PropsEnd;
+		if (Ar.ArVer >= 9) Ar << DirPos;
+		Ar.Seek(PropsEnd);
+	}
 }
 
 
@@ -49,56 +101,97 @@ void CObject::Serialize(CArchive &Ar)
 	Object serialization support
 -----------------------------------------------------------------------------*/
 
-static TArray<CObject*> ObjSerialize;
+int CSerializeContext::AddObject(CObject *Obj)
+{
+	int index = Objects.AddItem(Obj);
+	int hash  = GetHash(Obj);
+	HashNext.AddItem(HashHead[hash]);
+	HashHead[hash] = index;
+	return index;
+}
+
+
+int CSerializeContext::FindObject(const CObject *Obj) const
+{
+	int index;
+	for (index = HashHead[GetHash(Obj)]; index >= 0; index = HashNext[index])
+		if (Objects[index] == Obj)
+			break;
+	return index;
+}
+
 
 /*
  *	Serialize object link. Format in CArchive:
- *		1) string	ObjectClassName
- *		2) index	SerializeIndex
- *	All objects will be serialized immediately after main serializable object,
- *	in order of appearance. Link will be represented as position of object
- *	in serialization list.
- *	Note: ObjectClassName is stored for each link, but really required for
- *	1st object appearance only.
- *	Other approach is to create separate table with object information, and
- *	store this table in contiguous file space (current implementation spreads
- *	this 'table' between objects).
+ *		1) index	SerializeIndex
+ *		2) string	ObjectClassName		(ArVer < 5)
+ *	All objects will be serialized after main serializable object, in order of
+ *	appearance. Link will be represented as position of object in serialization
+ *	list.
+ *	Files of ArVer < 5 stores ObjectClassName for each link (required for 1st
+ *	object appearance only), objects are placed sequentially after main object.
+ *	Newer files has object table, see SerializeObject().
  */
 
+static CObject *CreateTableObject(const CObjectChunk &C)
+{
+	CObject *Obj = CreateClass(C.ClassName);
+	if (!Obj)
+		appError("Unknown class \"%s\"", *C.ClassName);
+	return Obj;
+}
+
+
 CArchive& operator<<(CArchive &Ar, CObject *&Obj)
 {
 	guard(operator<<(CObject*));
 
+	CSerializeContext *Ctx = Ar.ObjContext;
+	if (!Ctx)
+		appError("Object link outside of SerializeObject()");
+
 	TString<MAX_CLASS_NAME> ClassName;
 	int Index;
 
 	if (Ar.IsLoading)
 	{
-		Ar << AR_INDEX(Index) << ClassName;
-		if (Index >= ObjSerialize.Num())
+		Ar << AR_INDEX(Index);
+		if (Ar.ArVer >= 5)
+		{
+			// all objects were created from object table, or are created on first
+			// link (see LoadObjectChunk())
+			if (Index < 0 || Index >= Ctx->Objects.Num())
+				appError("Wrong object link %d", Index);
+			Obj = Ctx->Objects[Index];
+			if (!Obj)
+			{
+				assert(Ctx->Table);
+				Obj = Ctx->Objects[Index] = CreateTableObject((*Ctx->Table)[Index+1]);
+			}
+			return Ar;
+		}
+		Ar << ClassName;
+		if (Index >= Ctx->Objects.Num())
 		{
 			// new object link, create empty object
-			assert(Index == ObjSerialize.Num());
+			assert(Index == Ctx->Objects.Num());
 			Obj = CreateClass(ClassName);
-			ObjSerialize.AddItem(Obj);
+			Ctx->AddObject(Obj);
 		}
 		else
 		{
 			// object already created, duplicate link
-			Obj = ObjSerialize[Index];
+			Obj = Ctx->Objects[Index];
 			assert(ClassName == Obj->GetClassName());
 		}
 	}
 	else
 	{
 		// saving
-		ClassName = Obj->GetClassName();
-		// find object in ObjSerialize[]
-		for (Index = 0; Index < ObjSerialize.Num(); Index++)
-			if (ObjSerialize[Index] == Obj) break;
-		if (Index >= ObjSerialize.Num())		// new object link
-			Index = ObjSerialize.AddItem(Obj);
-		Ar << ClassName << AR_INDEX(Index);
+		Index = Ctx->FindObject(Obj);
+		if (Index < 0)							// new object link
+			Index = Ctx->AddObject(Obj);
+		Ar << AR_INDEX(Index);
 	}
 
 	return Ar;
@@ -106,55 +199,350 @@ CArchive& operator<<(CArchive &Ar, CObject *&Obj)
 }
 
 
+/*
+ *	Native file layout (ArVer >= 5):
+ *		index	ArVer
+ *		int		TableOffset			position of object table
+ *		qword	Hash				content hash (ArVer >= 6)
+ *		...							object data, aligned to OBJECT_ALIGNMENT
+ *		TArray<CObjectChunk>		object table
+ *	First object in table is main object, others are in order of serialization
+ *	context list.
+ *	Objects are serialized with file positions, so object could use Tell()/Seek()
+ *	to reference its own data.
+ *	Since ArVer 7 object data could be compressed with appCompressBlocks(); such
+ *	object is serialized from memory with positions it would have in uncompressed
+ *	file, and archive has IsUnpacked flag set.
+ *	Files of ArVer < 5 has no object table: objects are stored sequentially after
+ *	archive version, starting with main object.
+ */
+
+// Content hash is computed from data of all objects, in order of saving; it is
+// seeded with archive version, so files of older versions are always "changed".
+#define HASH_SEED		ARCHIVE_VERSION
+
+static void SaveObjectChunk(CObject *Obj, CArchive &Ar, CObjectChunk &C, qword &Hash, int Compression)
+{
+	guard(SaveObjectChunk);
+	// align object data
+	static const byte Zero[OBJECT_ALIGNMENT] = { 0 };
+	int Pad = Align(Ar.Tell(), OBJECT_ALIGNMENT) - Ar.Tell();
+	if (Pad) Ar.Serialize((void*)Zero, Pad);
+	// serialize object into memory to compute its checksum
+	CArchiveMem Mem(Ar.Tell());
+	Mem.ArVer      = Ar.ArVer;
+	Mem.ObjContext = Ar.ObjContext;			// share object links
+	Obj->Serialize(Mem);
+	C.ClassName = Obj->GetClassName();
+	C.Offset    = Ar.Tell();
+	C.RawSize   = Mem.GetDataSize();
+	C.Flags     = COMPRESS_NONE;
+	Hash        = appHash64(Mem.GetData(), C.RawSize, Hash);
+	const byte *Data = Mem.GetData();
+	C.Size      = C.RawSize;
+	// compress data; keep it uncompressed, when this will not help
+	TArray<byte> Packed;
+	if (Compression != COMPRESS_NONE)
+	{
+		appCompressBlocks(Data, C.RawSize, Packed, Compression);
+		if (Packed.Num() < C.RawSize)
+		{
+			Data    = &Packed[0];
+			C.Size  = Packed.Num();
+			C.Flags = Compression;
+		}
+	}
+	C.Checksum  = appCrc32(Data, C.Size);
+	Ar.Serialize((void*)Data, C.Size);
+	unguardf(("%s", Obj->GetClassName()));
+}
+
+
+// get pointer to data of object, as stored in file; Buffer is used when archive
+// has no direct memory access
+static const byte *ReadChunkData(CArchive &Ar, const CObjectChunk &C, TArray<byte> &Buffer)
+{
+	Ar.Seek(C.Offset);
+	const void *Data = Ar.View(C.Size);
+	if (!Data)
+	{
+		Buffer.Empty(C.Size);
+		Buffer.AddNoInit(C.Size);
+		Buffer.SerializeItems(Ar);
+		Data = C.Size ? &Buffer[0] : NULL;
+	}
+	return (const byte*)Data;
+}
+
+
+static void LoadObjectData(CObject *Obj, CArchive &Ar, const CObjectChunk &C)
+{
+	guard(LoadObjectData);
+	if (C.ClassName != Obj->GetClassName())
+		appError("Expected class \"%s\", but found \"%s\"", Obj->GetClassName(), *C.ClassName);
+	if (C.Flags != COMPRESS_NONE)
+	{
+		// decompress object data, then serialize object from memory; archive positions
+		// are preserved, but they are not file positions anymore
+		TArray<byte> Buffer, Raw;
+		Ar.SetStopper(C.Offset + C.Size);
+		const byte *Data = ReadChunkData(Ar, C, Buffer);
+		Ar.SetStopper(0);
+		Raw.Add(C.RawSize);
+		appDecompressBlocks(Data, C.Size, C.RawSize ? &Raw[0] : NULL, C.RawSize);
+		CArchiveMem Mem(C.RawSize ? &Raw[0] : NULL, C.RawSize, C.Offset);
+		Mem.ArVer      = Ar.ArVer;
+		Mem.ObjContext = Ar.ObjContext;
+		Mem.IsUnpacked = true;
+		Obj->Serialize(Mem);
+		if (Mem.Tell() != C.Offset + C.RawSize)
+			appError("Object size mismatch: %d != %d", Mem.Tell() - C.Offset, C.RawSize);
+		return;
+	}
+	Ar.Seek(C.Offset);
+	Ar.SetStopper(C.Offset + C.Size);
+	Obj->Serialize(Ar);
+	if (Ar.Tell() != C.Offset + C.Size)
+		appError("Object size mismatch: %d != %d", Ar.Tell() - C.Offset, C.Size);
+	Ar.SetStopper(0);
+	unguardf(("%s", Obj->GetClassName()));
+}
+
+
+// read header of file with object table, should be called after reading ArVer;
+// Hash is set to 0 when file has no content hash
+static void ReadHeader(CArchive &Ar, int &TableOffset, qword &Hash)
+{
+	Ar << TableOffset;
+	Hash = 0;
+	if (Ar.ArVer >= 6)
+		Ar << Hash;
+}
+
+
+// read object table and verify, that all entries are inside the file, so damaged
+// file will not cause access to data behind its end
+static void ReadObjectTableInternal(CArchive &Ar, TArray<CObjectChunk> &Table)
+{
+	int TableOffset;
+	qword Hash;
+	ReadHeader(Ar, TableOffset, Hash);
+	int EndPos = Ar.GetEndPos();
+	if (TableOffset < 0 || (EndPos >= 0 && TableOffset > EndPos))
+		appError("Wrong object table position %d", TableOffset);
+	Ar.Seek(TableOffset);
+	Ar << Table;
+	if (!Table.Num())
+		appError("Empty object table");
+	for (int i = 0; i < Table.Num(); i++)
+	{
+		const CObjectChunk &C = Table[i];
+		if (C.Offset < 0 || C.Size < 0 || C.RawSize < 0 ||
+			(EndPos >= 0 && C.Size > EndPos - C.Offset))
+			appError("Object %d (%s) has wrong position: %d+%d", i, *C.ClassName, C.Offset, C.Size);
+	}
+}
+
+
+// create objects for table entries [1..N-1]
+static void CreateTableObjects(CSerializeContext &Ctx, const TArray<CObjectChunk> &Table)
+{
+	for (int i = 1; i < Table.Num(); i++)
+		Ctx.AddObject(CreateTableObject(Table[i]));
+}
+
+
 //?? try to reduce function count: InternalLoad(), SerializeObject() ...
-void SerializeObject(CObject *Obj, CArchive &Ar)
+void SerializeObject(CObject *Obj, CArchive &Ar, int Compression)
 {
 	guard(SerializeObject);
 
-	// NOTE: should not remove entries from ObjSerialize[] until end of process
-	// (required by operator<<(Ar,Obj) function)
+	// object list, used by operator<<(Ar,Obj) function
+	CSerializeContext Ctx(Ar);
 
-	// serialize archive version
+	int index;
 	if (Ar.IsLoading)
 	{
 		// get archive version
 		Ar << AR_INDEX(Ar.ArVer);
 		if (Ar.ArVer <= 0 || Ar.ArVer > ARCHIVE_VERSION)
 			appError("Loading file of a newer version %d, current version is " STR(ARCHIVE_VERSION), Ar.ArVer);
+		if (Ar.ArVer >= 5)
+		{
+			TArray<CObjectChunk> Table;
+			ReadObjectTableInternal(Ar, Table);
+			int EndPos = Ar.Tell();
+			CreateTableObjects(Ctx, Table);
+			LoadObjectData(Obj, Ar, Table[0]);
+			for (index = 0; index < Ctx.Objects.Num(); index++)
+				LoadObjectData(Ctx.Objects[index], Ar, Table[index+1]);
+			Ar.Seek(EndPos);
+		}
+		else
+		{
+			// sequential layout
+			Obj->Serialize(Ar);
+			index = 0;
+			while (index < Ctx.Objects.Num())
+				Ctx.Objects[index++]->Serialize(Ar);
+		}
+		// call PostLoad() for all loaded objects
+		Obj->PostLoad();
+		for (index = 0; index < Ctx.Objects.Num(); index++)
+			Ctx.Objects[index]->PostLoad();
 	}
 	else
 	{
 		Ar.ArVer = ARCHIVE_VERSION;
 		Ar << AR_INDEX(Ar.ArVer);
+		// write placeholder for header
+		int HeaderPos = Ar.Tell();
+		int TableOffset = 0;
+		qword Hash = HASH_SEED;
+		Ar << TableOffset << Hash;
+		// serialize main object and subobjects
+		TArray<CObjectChunk> Table;
+		Table.Add();
+		SaveObjectChunk(Obj, Ar, Table[0], Hash, Compression);
+		for (index = 0; index < Ctx.Objects.Num(); index++)
+			SaveObjectChunk(Ctx.Objects[index], Ar, Table[Table.Add()], Hash, Compression);
+		// write object table
+		TableOffset = Ar.Tell();
+		Ar << Table;
+		// patch header
+		int EndPos = Ar.Tell();
+		Ar.Seek(HeaderPos);
+		Ar << TableOffset << Hash;
+		Ar.Seek(EndPos);
 	}
+	unguard;
+}
 
-	// serialize main object
-	Obj->Serialize(Ar);
-	// serialize subobjects, if needed
-	int index = 0;
-	while (index < ObjSerialize.Num())
-		ObjSerialize[index++]->Serialize(Ar);
 
-	// call PostLoad() for all loaded objects
-	if (Ar.IsLoading)
+bool ReadObjectTable(CArchive &Ar, TArray<CObjectChunk> &Table)
+{
+	guard(ReadObjectTable);
+	Ar.Seek(0);
+	Ar << AR_INDEX(Ar.ArVer);
+	if (Ar.ArVer <= 0 || Ar.ArVer > ARCHIVE_VERSION)
+		appError("Loading file of a newer version %d, current version is " STR(ARCHIVE_VERSION), Ar.ArVer);
+	if (Ar.ArVer < 5)
+		return false;
+	ReadObjectTableInternal(Ar, Table);
+	return true;
+	unguard;
+}
+
+
+int VerifyObjectTable(CArchive &Ar, const TArray<CObjectChunk> &Table)
+{
+	guard(VerifyObjectTable);
+	int NumErrors = 0;
+	TArray<byte> Buffer;
+	for (int i = 0; i < Table.Num(); i++)
 	{
-		Obj->PostLoad();
-		for (index = 0; index < ObjSerialize.Num(); index++)
-			ObjSerialize[index]->PostLoad();
+		const CObjectChunk &C = Table[i];
+		const byte *Data = ReadChunkData(Ar, C, Buffer);
+		if (appCrc32(Data, C.Size) != C.Checksum)
+		{
+			appNotify("Object %d (%s) is damaged", i, *C.ClassName);
+			NumErrors++;
+		}
 	}
+	return NumErrors;
+	unguard;
+}
+
+
+CObject *LoadObjectChunk(CArchive &Ar, const TArray<CObjectChunk> &Table, int Index)
+{
+	guard(LoadObjectChunk);
+	assert(Index >= 0 && Index < Table.Num());
+	CSerializeContext Ctx(Ar);
+	// objects are created on first link, so only objects, referenced by this one,
+	// are created
+	Ctx.Table = &Table;
+	Ctx.Objects.Add(Table.Num() - 1);
+	CObject *Obj = CreateTableObject(Table[Index]);
+	if (Index > 0)
+		Ctx.Objects[Index-1] = Obj;
+	LoadObjectData(Obj, Ar, Table[Index]);
+	Obj->PostLoad();
+	return Obj;
+	unguardf(("%d", Index));
+}
+
+
+/*-----------------------------------------------------------------------------
+	Change detection
+-----------------------------------------------------------------------------*/
+
+// serialize object into memory, returns content hash
+static qword SaveObjectToMemory(CObject *Obj, CArchiveMem &Mem, int Compression = COMPRESS_NONE)
+{
+	SerializeObject(Obj, Mem, Compression);
+	CArchiveMem Ar(Mem.GetData(), Mem.GetDataSize());
+	Ar << AR_INDEX(Ar.ArVer);
+	int TableOffset;
+	qword Hash;
+	ReadHeader(Ar, TableOffset, Hash);
+	return Hash;
+}
+
 
-	// remove all objects from ObjSerialize list
-	ObjSerialize.Empty();
+qword GetObjectHash(CObject *Obj)
+{
+	guard(GetObjectHash);
+	CArchiveMem Mem;
+	return SaveObjectToMemory(Obj, Mem);
 	unguard;
 }
 
 
+bool ReadObjectHash(const char *Filename, qword &Hash)
+{
+	guard(ReadObjectHash);
+	FILE *f = fopen(Filename, "rb");
+	if (!f) return false;
+	CFile Ar(f);						// will close file
+	// verify file size to not fail on a damaged file
+	fseek(f, 0, SEEK_END);
+	int Size = ftell(f);
+	fseek(f, 0, SEEK_SET);
+	if (Size < 16) return false;		// ArVer + TableOffset + Hash, with a margin
+	Ar << AR_INDEX(Ar.ArVer);
+	if (Ar.ArVer < 6 || Ar.ArVer > ARCHIVE_VERSION)
+		return false;
+	int TableOffset;
+	ReadHeader(Ar, TableOffset, Hash);
+	return true;
+	unguardf(("%s", Filename));
+}
+
+
+bool SaveObjectFile(CObject *Obj, const char *Filename, qword *SavedHash, int Compression)
+{
+	guard(SaveObjectFile);
+	CArchiveMem Mem;
+	qword Hash = SaveObjectToMemory(Obj, Mem, Compression);
+	if (SavedHash) *SavedHash = Hash;
+	qword OldHash;
+	if (ReadObjectHash(Filename, OldHash) && OldHash == Hash)
+		return false;					// file is not changed
+	CFile Ar(Filename, false);
+	Ar.Serialize((void*)Mem.GetData(), Mem.GetDataSize());
+	Ar.Close();
+	return true;
+	unguardf(("%s", Filename));
+}
+
+
 #if EDITOR
 
 bool CObject::InternalLoad(const char *From)
 {
-	CFile Ar(From);
-	if (!Ar.IsOpen()) return false;
+	CMappedFile Ar;
+	if (!Ar.Open(From)) return false;
 	SerializeObject(this, Ar);
 	return true;
 }
@@ -166,23 +554,32 @@ bool CObject::InternalLoad(const char *From)
 	Class registry
 -----------------------------------------------------------------------------*/
 
+#define CLASS_HASH_SIZE		256
+
 static CClassInfo* GClasses    = NULL;
 static int         GClassCount = 0;
+static CClassInfo* GClassHash[CLASS_HASH_SIZE];
 
 void RegisterClasses(CClassInfo *Table, int Count)
 {
 	assert(GClasses == NULL);		// no multiple tables
 	GClasses    = Table;
 	GClassCount = Count;
+	for (int i = 0; i < Count; i++)
+	{
+		int Hash = appStrHash(Table[i].Name) & (CLASS_HASH_SIZE-1);
+		Table[i].HashNext = GClassHash[Hash];
+		GClassHash[Hash]  = &Table[i];
+	}
 }
 
 
 CObject *CreateClass(const char *Name)
 {
-	for (int i = 0; i < GClassCount; i++)
-		if (!strcmp(GClasses[i].Name, Name))
+	for (const CClassInfo *Info = GClassHash[appStrHash(Name) & (CLASS_HASH_SIZE-1)]; Info; Info = Info->HashNext)
+		if (!strcmp(Info->Name, Name))
 		{
-			CObject *Obj = GClasses[i].Constructor();
+			CObject *Obj = Info->Constructor();
 			return Obj;
 		}
 	return NULL;
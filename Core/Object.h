@@ -1,6 +1,8 @@
 #undef DECLARE_CLASS		// defined in wxWidgets
 
-#define ARCHIVE_VERSION		1
+#define ARCHIVE_VERSION		9
+
+#define MAX_CLASS_NAME		256
 
 /*-----------------------------------------------------------------------------
 	Base object class
@@ -12,6 +14,8 @@
 class CObject
 {
 public:
+	DECLARE_ALLOCATOR
+
 	virtual ~CObject()
 	{}
 	virtual void PostLoad()
@@ -25,7 +29,136 @@ protected:
 	bool InternalLoad(const char *From);
 };
 
-void SerializeObject(CObject *Obj, CArchive &Ar);
+/**
+ * Load or save object together with all referenced objects. 'Compression' is a
+ * combination of COMPRESS_... flags, used when saving.
+ */
+void SerializeObject(CObject *Obj, CArchive &Ar, int Compression = COMPRESS_NONE);
+
+
+/*-----------------------------------------------------------------------------
+	Object serialization context
+-----------------------------------------------------------------------------*/
+
+#define OBJ_HASH_SIZE		256
+
+struct CObjectChunk;
+
+/**
+ * List of objects, serialized together with the main object (object links are
+ * stored as indices in this list). Context is attached to archive for its lifetime,
+ * so different archives could be serialized simultaneously in different threads.
+ */
+class CSerializeContext
+{
+public:
+	TArray<CObject*>	Objects;
+	// when set, Objects has NULL entries for objects, which are created from this
+	// table on first link
+	const TArray<CObjectChunk> *Table;
+
+	CSerializeContext(CArchive &InAr)
+	:	Table(NULL)
+	,	Ar(InAr)
+	,	OldContext(InAr.ObjContext)
+	{
+		memset(HashHead, -1, sizeof(HashHead));
+		Ar.ObjContext = this;
+	}
+
+	~CSerializeContext()
+	{
+		Ar.ObjContext = OldContext;
+	}
+
+	int AddObject(CObject *Obj);
+	// returns -1 when object is not in list
+	int FindObject(const CObject *Obj) const;
+
+protected:
+	CArchive			&Ar;
+	CSerializeContext	*OldContext;
+	int					HashHead[OBJ_HASH_SIZE];
+	TArray<int>			HashNext;
+
+	static int GetHash(const CObject *Obj)
+	{
+		size_t v = (size_t)Obj;
+		return ((v >> 4) ^ (v >> 12)) & (OBJ_HASH_SIZE - 1);	// objects are aligned, skip low bits
+	}
+};
+
+
+/*-----------------------------------------------------------------------------
+	Object table of native files (ArVer >= 5)
+-----------------------------------------------------------------------------*/
+
+#define OBJECT_ALIGNMENT	16			// alignment of object data in file
+
+/**
+ * Object table entry, describes location of a single serialized object in file
+ */
+struct CObjectChunk
+{
+	TString<MAX_CLASS_NAME> ClassName;
+	int			Offset;					// position of object data in file
+	int			Size;					// size of data in file
+	unsigned	Checksum;				// appCrc32() of object data, as stored in file
+	int			Flags;					// COMPRESS_... flags (ArVer >= 7)
+	int			RawSize;				// size of data after decompression
+
+	friend CArchive& operator<<(CArchive &Ar, CObjectChunk &C)
+	{
+		Ar << C.ClassName << C.Offset << C.Size << C.Checksum;
+		if (Ar.ArVer >= 7)
+			Ar << C.Flags << C.RawSize;
+		else if (Ar.IsLoading)
+		{
+			C.Flags   = COMPRESS_NONE;
+			C.RawSize = C.Size;
+		}
+		return Ar;
+	}
+};
+
+/**
+ * Read object table of native file. Returns false when file has no object table
+ * (ArVer < 5). First entry describes the main object.
+ */
+bool ReadObjectTable(CArchive &Ar, TArray<CObjectChunk> &Table);
+/**
+ * Verify checksums of all objects without loading them. Returns number of damaged
+ * objects. Compressed objects are verified without decompression.
+ */
+int VerifyObjectTable(CArchive &Ar, const TArray<CObjectChunk> &Table);
+/**
+ * Load a single object from file. Objects, referenced by this object, are created,
+ * but not loaded; they are reachable through links of returned object only, so caller
+ * owns them as well. Objects, which are not referenced, are not created.
+ */
+CObject *LoadObjectChunk(CArchive &Ar, const TArray<CObjectChunk> &Table, int Index);
+
+
+/*-----------------------------------------------------------------------------
+	Change detection (ArVer >= 6)
+-----------------------------------------------------------------------------*/
+
+/**
+ * Content hash of object: the same value will be stored in file header, when object
+ * is saved with SerializeObject(). Object is serialized into memory for this.
+ */
+qword GetObjectHash(CObject *Obj);
+/**
+ * Read content hash from file header. Returns false when file is missing or has
+ * no hash (ArVer < 6).
+ */
+bool ReadObjectHash(const char *Filename, qword &Hash);
+/**
+ * Save object to file, when file is missing or has different content. Returns
+ * false when saving was skipped. 'SavedHash' receives content hash of the object.
+ * Hash is computed from uncompressed data, so it does not depend on 'Compression'.
+ */
+bool SaveObjectFile(CObject *Obj, const char *Filename, qword *SavedHash = NULL, int Compression = COMPRESS_NONE);
 
 
 #define DECLARE_BASE_CLASS(Class)					\
@@ -75,6 +208,7 @@ struct CClassInfo
 {
 	const char *Name;
 	CObject* (*Constructor)();
+	CClassInfo *HashNext;			// filled by RegisterClasses()
 };
 
 #define BEGIN_CLASS_TABLE						\
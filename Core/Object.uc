@@ -58,4 +58,4 @@ struct Color3f
  *	CObject internal layout
  *---------------------------------------------------------------------------*/
 
-var int VmtPtr;		// internal VMT pointer
+var transient pointer VmtPtr;	// internal VMT pointer
@@ -52,7 +52,7 @@ char *appStrdup(const char *str)
 {
 //	MEM_ALLOCATOR(str);
 	int size = strlen(str) + 1;
-	char *out = (char*)appMalloc(size);
+	char *out = (char*)appMallocNoInit(size);
 	memcpy(out, str, size);
 	return out;
 }
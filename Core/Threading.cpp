@@ -0,0 +1,659 @@
+#if _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <unistd.h>					// sysconf
+#include <pthread.h>
+#include <semaphore.h>
+#include <sched.h>					// sched_yield
+#include <errno.h>
+#endif
+
+#include "Core.h"
+
+
+/*-----------------------------------------------------------------------------
+	Multithreading helpers
+-----------------------------------------------------------------------------*/
+
+#define MAX_THREADS			64
+
+
+int appGetNumCores()
+{
+	static int NumCores = 0;
+	if (!NumCores)
+	{
+#if _WIN32
+		SYSTEM_INFO si;
+		GetSystemInfo(&si);
+		NumCores = si.dwNumberOfProcessors;
+#else
+		NumCores = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+		NumCores = bound(NumCores, 1, MAX_THREADS);
+	}
+	return NumCores;
+}
+
+
+static volatile int LastThreadId = 0;
+static THREAD_LOCAL int ThreadId = 0;
+
+int appGetThreadId()
+{
+	if (!ThreadId)
+		ThreadId = appInterlockedAdd(&LastThreadId, 1) + 1;
+	return ThreadId;
+}
+
+
+void appYield()
+{
+#if _WIN32
+	Sleep(0);
+#else
+	sched_yield();
+#endif
+}
+
+
+static void SleepThread(int ms)
+{
+#if _WIN32
+	Sleep(ms);
+#else
+	usleep(ms * 1000);
+#endif
+}
+
+
+void CCriticalSection::Enter()
+{
+	int Id = appGetThreadId();
+	if (Owner == Id)
+	{
+		// recursive call
+		Depth++;
+		return;
+	}
+	while (appInterlockedExchange(&Lock, 1))
+		appYield();
+	Owner = Id;
+	Depth = 1;
+}
+
+
+void CCriticalSection::Leave()
+{
+	assert(Owner == appGetThreadId());
+	if (--Depth) return;
+	Owner = 0;
+	appInterlockedExchange(&Lock, 0);
+}
+
+
+/*-----------------------------------------------------------------------------
+	Worker threads
+	Every job thread has a queue, protected with a spin lock. Owner thread pushes
+	and pops jobs at the tail (LIFO order, data is hot in cache), other threads
+	steal from the head. Queue #0 is shared by all threads, which are not workers.
+	Idle workers sleep on a semaphore: NumSleeping counts workers, which are going
+	to sleep, minus posted wakeups; it is checked after PendingJobs is changed,
+	and PendingJobs is checked after NumSleeping is changed, so a queued job could
+	not be missed.
+-----------------------------------------------------------------------------*/
+
+#define JOB_QUEUE_SIZE		1024			// power of 2
+#define JOB_SPIN_COUNT		64				// number of attempts to find a job before sleeping
+#define WAIT_SPIN_COUNT		256				// number of yields before waiting thread starts sleeping
+
+struct CJob
+{
+	JobFunc			Func;
+	void			*Param;
+	CJobCounter		*Counter;
+	CJob			*Next;					// list of jobs in CJobCounter::Waiting
+	bool			Cancelled;				// dependency has failed
+#if MEM_STATS
+	int				MemTag;					// allocation tag of the thread, which started the job
+#endif
+};
+
+struct CJobQueue
+{
+	volatile int	Lock;
+	volatile int	Head;
+	volatile int	Tail;
+	CJob			*Jobs[JOB_QUEUE_SIZE];
+};
+
+static CJobQueue	Queues[MAX_THREADS];
+static int			NumQueues = 1;
+static int			NumWorkers = 0;
+static volatile int	JobsInitialized = 0;
+static volatile int	JobsQuit = 0;
+static volatile int	PendingJobs = 0;		// number of jobs in all queues
+static volatile int	NumSleeping = 0;
+static volatile int	InitLock = 0;
+static THREAD_LOCAL int QueueIndex = 0;		// queue of the current thread
+
+#if _WIN32
+static HANDLE		WorkerSemaphore;
+static HANDLE		Workers[MAX_THREADS];
+#else
+static sem_t		WorkerSemaphore;
+static pthread_t	Workers[MAX_THREADS];
+#endif
+
+
+static FORCEINLINE void LockSpin(volatile int &Lock)
+{
+	while (appInterlockedExchange(&Lock, 1))
+	{
+		// spin, lock is held for a short time
+	}
+}
+
+static FORCEINLINE void UnlockSpin(volatile int &Lock)
+{
+	appInterlockedExchange(&Lock, 0);
+}
+
+
+static void WakeWorker()
+{
+	while (true)
+	{
+		int n = NumSleeping;
+		if (n <= 0) return;
+		if (appInterlockedCompareExchange(&NumSleeping, n - 1, n) == n)
+			break;
+	}
+#if _WIN32
+	ReleaseSemaphore(WorkerSemaphore, 1, NULL);
+#else
+	sem_post(&WorkerSemaphore);
+#endif
+}
+
+
+static void SleepWorker()
+{
+	appInterlockedAdd(&NumSleeping, 1);
+	if (PendingJobs > 0 || JobsQuit)
+	{
+		// job was queued meanwhile: cancel sleeping, if wakeup was not posted yet
+		while (true)
+		{
+			int n = NumSleeping;
+			if (n <= 0) break;
+			if (appInterlockedCompareExchange(&NumSleeping, n - 1, n) == n)
+				return;
+		}
+	}
+#if _WIN32
+	WaitForSingleObject(WorkerSemaphore, INFINITE);
+#else
+	while (sem_wait(&WorkerSemaphore) && errno == EINTR)
+	{
+		// interrupted by signal
+	}
+#endif
+}
+
+
+static bool PushJob(CJob *Job)
+{
+	CJobQueue &Q = Queues[QueueIndex];
+	LockSpin(Q.Lock);
+	if (Q.Tail - Q.Head >= JOB_QUEUE_SIZE)
+	{
+		UnlockSpin(Q.Lock);
+		return false;
+	}
+	Q.Jobs[Q.Tail & (JOB_QUEUE_SIZE - 1)] = Job;
+	Q.Tail++;
+	UnlockSpin(Q.Lock);
+	appInterlockedAdd(&PendingJobs, 1);
+	WakeWorker();
+	return true;
+}
+
+
+static CJob *PopJob(CJobQueue &Q, bool Own)
+{
+	if (Q.Head == Q.Tail) return NULL;		// fast check without locking
+	LockSpin(Q.Lock);
+	CJob *Job = NULL;
+	if (Q.Head != Q.Tail)
+	{
+		if (Own)
+			Job = Q.Jobs[--Q.Tail & (JOB_QUEUE_SIZE - 1)];
+		else
+			Job = Q.Jobs[Q.Head++ & (JOB_QUEUE_SIZE - 1)];
+	}
+	UnlockSpin(Q.Lock);
+	if (Job)
+		appInterlockedAdd(&PendingJobs, -1);
+	return Job;
+}
+
+
+static CJob *FindJob()
+{
+	int Self = QueueIndex;
+	CJob *Job = PopJob(Queues[Self], true);
+	if (Job) return Job;
+	// steal from other threads
+	for (int i = 1; i < NumQueues; i++)
+	{
+		int Index = Self + i;
+		if (Index >= NumQueues) Index -= NumQueues;
+		Job = PopJob(Queues[Index], false);
+		if (Job) return Job;
+	}
+	return NULL;
+}
+
+
+static char *CopyError(const char *History)
+{
+	int len = strlen(History) + 1;
+	char *Error = (char*)appMallocNoInit(len);
+	memcpy(Error, History, len);
+	return Error;
+}
+
+
+static void FailCounter(CJobCounter *Counter, const char *History)
+{
+	if (!Counter)
+	{
+		appNotify("ERROR in job: %s", History);
+		return;
+	}
+	LockSpin(Counter->Lock);
+	if (!Counter->Error)					// keep the first error only
+		Counter->Error = CopyError(History);
+	UnlockSpin(Counter->Lock);
+}
+
+
+static void QueueJob(CJob *Job);
+
+static void FinishJob(CJob *Job)
+{
+	CJobCounter *Counter = Job->Counter;
+	appFree(Job);
+	if (!Counter) return;
+
+	CJob *Ready = NULL;
+	char *Error = NULL;
+	LockSpin(Counter->Lock);
+	if (appInterlockedAdd(&Counter->Count, -1) == 1)
+	{
+		// last job: release dependent jobs
+		Ready = Counter->Waiting;
+		Counter->Waiting = NULL;
+		if (Ready && Counter->Error)
+			Error = CopyError(Counter->Error);
+	}
+	// this is the last access to Counter: waiting thread may release it after unlocking
+	UnlockSpin(Counter->Lock);
+
+	while (Ready)
+	{
+		CJob *Next = Ready->Next;
+		if (Error)
+		{
+			Ready->Cancelled = true;
+			FailCounter(Ready->Counter, Error);
+		}
+		QueueJob(Ready);
+		Ready = Next;
+	}
+	if (Error) appFree(Error);
+}
+
+
+static void ExecuteJob(CJob *Job)
+{
+	if (!Job->Cancelled)
+	{
+		MEM_TAG(Job->MemTag);
+#if DO_GUARD_SHADOW
+		// error history of the job should not have functions of the thread, which
+		// executes this job while waiting for other jobs
+		int SavedBase = GGuardStack.Base;
+		GGuardStack.Base = GGuardStack.Depth;
+#endif
+		try
+		{
+			Job->Func(Job->Param);
+		}
+		catch (...)
+		{
+			FailCounter(Job->Counter, GErrorHistory);
+			appResetError();
+		}
+#if DO_GUARD_SHADOW
+		GGuardStack.Base = SavedBase;
+#endif
+	}
+	FinishJob(Job);
+}
+
+
+static void QueueJob(CJob *Job)
+{
+	// execute immediately when queue is full, or when there are no workers, which
+	// would execute jobs, that are never waited for
+	if (!NumWorkers || !PushJob(Job))
+		ExecuteJob(Job);
+}
+
+
+static void JobWorker(int Index)
+{
+	QueueIndex = Index;
+	while (!JobsQuit)
+	{
+		CJob *Job = NULL;
+		for (int spin = 0; spin < JOB_SPIN_COUNT && !Job && !JobsQuit; spin++)
+		{
+			Job = FindJob();
+			if (!Job) appYield();
+		}
+		if (Job)
+			ExecuteJob(Job);
+		else
+			SleepWorker();
+	}
+	appReleaseThreadCache();
+}
+
+
+#if _WIN32
+static DWORD WINAPI WorkerThread(void *Param)
+{
+	JobWorker((int)(size_t)Param);
+	return 0;
+}
+#else
+static void* WorkerThread(void *Param)
+{
+	JobWorker((int)(size_t)Param);
+	return NULL;
+}
+#endif
+
+
+static void ShutdownJobs()
+{
+	JobsQuit = 1;
+	int i;
+#if _WIN32
+	ReleaseSemaphore(WorkerSemaphore, NumWorkers, NULL);
+	WaitForMultipleObjects(NumWorkers, Workers, TRUE, INFINITE);
+	for (i = 0; i < NumWorkers; i++)
+		CloseHandle(Workers[i]);
+#else
+	for (i = 0; i < NumWorkers; i++)
+		sem_post(&WorkerSemaphore);
+	for (i = 0; i < NumWorkers; i++)
+		pthread_join(Workers[i], NULL);
+#endif
+	// jobs, which were not waited for, are dropped
+}
+
+
+static void InitJobs()
+{
+	LockSpin(InitLock);
+	if (JobsInitialized)
+	{
+		UnlockSpin(InitLock);
+		return;
+	}
+
+	// errors are not thrown here: InitLock is held, and other threads would spin
+	// forever; when workers could not be created, jobs are executed serially
+
+	// caller thread executes jobs while waiting for them, but there should be at
+	// least one worker for jobs, which are never waited for
+	NumWorkers = max(appGetNumCores() - 1, 1);
+#if _WIN32
+	WorkerSemaphore = CreateSemaphore(NULL, 0, 0x7FFFFFFF, NULL);
+	bool SemaphoreOk = WorkerSemaphore != NULL;
+#else
+	bool SemaphoreOk = sem_init(&WorkerSemaphore, 0, 0) == 0;
+#endif
+	if (!SemaphoreOk)
+	{
+		appNotify("WARNING: unable to create semaphore, jobs will be executed serially");
+		NumWorkers = 0;
+	}
+	for (int i = 0; i < NumWorkers; i++)
+	{
+		void *Param = (void*)(size_t)(i + 1);
+#if _WIN32
+		Workers[i] = CreateThread(NULL, 0, WorkerThread, Param, 0, NULL);
+		bool ThreadOk = Workers[i] != NULL;
+#else
+		bool ThreadOk = pthread_create(&Workers[i], NULL, WorkerThread, Param) == 0;
+#endif
+		if (!ThreadOk)
+		{
+			appNotify("WARNING: unable to create job thread %d", i + 1);
+			NumWorkers = i;
+			break;
+		}
+	}
+	// without workers, job queues are not used at all (see QueueJob())
+	NumQueues = NumWorkers + 1;
+	if (SemaphoreOk)
+		atexit(ShutdownJobs);
+
+	appInterlockedExchange(&JobsInitialized, 1);
+	UnlockSpin(InitLock);
+}
+
+
+/*-----------------------------------------------------------------------------
+	Job API
+-----------------------------------------------------------------------------*/
+
+int appGetNumJobThreads()
+{
+	if (!JobsInitialized)
+		InitJobs();
+	return NumQueues;
+}
+
+
+void appRunJob(JobFunc Func, void *Param, CJobCounter *Counter, CJobCounter *Dependency)
+{
+	guard(appRunJob);
+
+	if (!JobsInitialized)
+		InitJobs();
+
+	CJob *Job = (CJob*)appMallocNoInit(sizeof(CJob));
+	Job->Func      = Func;
+	Job->Param     = Param;
+	Job->Counter   = Counter;
+	Job->Next      = NULL;
+	Job->Cancelled = false;
+#if MEM_STATS
+	Job->MemTag    = GMemTag;
+#endif
+	if (Counter)
+		appInterlockedAdd(&Counter->Count, 1);
+
+	if (Dependency)
+	{
+		LockSpin(Dependency->Lock);
+		if (Dependency->Count)
+		{
+			// will be queued by the last job of Dependency
+			Job->Next = Dependency->Waiting;
+			Dependency->Waiting = Job;
+			UnlockSpin(Dependency->Lock);
+			return;
+		}
+		if (Dependency->Error)
+		{
+			Job->Cancelled = true;
+			FailCounter(Counter, Dependency->Error);
+		}
+		UnlockSpin(Dependency->Lock);
+	}
+
+	QueueJob(Job);
+
+	unguard;
+}
+
+
+// wait for jobs without throwing errors
+static void WaitCounter(CJobCounter &Counter)
+{
+	int Spin = 0;
+	while (Counter.Count)
+	{
+		CJob *Job = FindJob();
+		if (Job)
+		{
+			ExecuteJob(Job);
+			Spin = 0;
+			continue;
+		}
+		// nothing to do: jobs of the counter are executed by other threads
+		if (++Spin < WAIT_SPIN_COUNT)
+			appYield();
+		else
+			SleepThread(1);
+	}
+	// synchronize with FinishJob(), which may still hold the lock
+	LockSpin(Counter.Lock);
+	UnlockSpin(Counter.Lock);
+}
+
+
+void appWaitJobs(CJobCounter &Counter)
+{
+	guard(appWaitJobs);
+
+	WaitCounter(Counter);
+	if (Counter.Error)
+	{
+		char History[ARRAY_COUNT(GErrorHistory)];
+		appStrncpyz(History, Counter.Error, sizeof(History));
+		appFree(Counter.Error);
+		Counter.Error = NULL;
+		appRethrowError(History);
+	}
+
+	unguard;
+}
+
+
+CJobCounter::~CJobCounter()
+{
+	WaitCounter(*this);
+	if (Error) appFree(Error);
+}
+
+
+/*-----------------------------------------------------------------------------
+	Parallel for
+-----------------------------------------------------------------------------*/
+
+struct CParallelFor
+{
+	ParallelFunc	Func;
+	void			*Param;
+	int				Count;
+	int				Grain;
+	volatile int	NextIndex;
+	volatile int	Failed;
+};
+
+
+static void ParallelJob(void *Param)
+{
+	CParallelFor *Ctx = (CParallelFor*)Param;
+	while (!Ctx->Failed)
+	{
+		int First = appInterlockedAdd(&Ctx->NextIndex, Ctx->Grain);
+		if (First >= Ctx->Count) break;
+		int Last = min(First + Ctx->Grain, Ctx->Count);
+		try
+		{
+			for (int i = First; i < Last; i++)
+				Ctx->Func(i, Ctx->Param);
+		}
+		catch (...)
+		{
+			// stop other jobs; error is passed to the waiting thread by the job system
+			Ctx->Failed = 1;
+			THROW_AGAIN;
+		}
+	}
+}
+
+
+void appParallelFor(int Count, ParallelFunc Func, void *Param, int MaxThreads, int Grain)
+{
+	guard(appParallelFor);
+
+	if (Count <= 0) return;
+	int NumThreads = MaxThreads ? MaxThreads : appGetNumJobThreads();
+	// by default make a few chunks per thread for load balancing
+	if (Grain <= 0)
+		Grain = max(Count / (NumThreads * 4), 1);
+	int NumChunks = (Count + Grain - 1) / Grain;
+	NumThreads = bound(NumThreads, 1, min(NumChunks, MAX_THREADS));
+	if (NumThreads <= 1)
+	{
+		// serial execution
+		for (int i = 0; i < Count; i++)
+			Func(i, Param);
+		return;
+	}
+
+	CParallelFor Ctx;
+	Ctx.Func      = Func;
+	Ctx.Param     = Param;
+	Ctx.Count     = Count;
+	Ctx.Grain     = Grain;
+	Ctx.NextIndex = 0;
+	Ctx.Failed    = 0;
+
+	// start jobs; caller thread is working too
+	CJobCounter Counter;
+	for (int i = 0; i < NumThreads - 1; i++)
+		appRunJob(ParallelJob, &Ctx, &Counter);
+	bool Failed = false;
+	try
+	{
+		ParallelJob(&Ctx);
+	}
+	catch (...)
+	{
+		Failed = true;
+	}
+	if (Failed)
+	{
+		// Ctx is used by other jobs, wait for them; waiting thread may execute
+		// other jobs, which will reset error history, so save it
+		char History[ARRAY_COUNT(GErrorHistory)];
+		appStrncpyz(History, GErrorHistory, sizeof(History));
+		WaitCounter(Counter);
+		appRethrowError(History, false);
+	}
+	appWaitJobs(Counter);
+
+	unguard;
+}
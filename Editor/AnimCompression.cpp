@@ -1,5 +1,6 @@
 #include "Core.h"
 #include "AnimClasses.h"
+#include "AnimCompression.h"
 
 
 //#define DEBUG_COMPRESS		1
@@ -17,34 +18,40 @@ static bool QuatsSame(const CQuat &Q1, const CQuat &Q2)
 	return SAME(Q1.x, Q2.x) && SAME(Q1.y, Q2.y) && SAME(Q1.z, Q2.z) && SAME(Q1.w, Q2.w);
 }
 
+template<class T> static void CopyArray(TArray<T> &Dst, const TArray<T> &Src)
+{
+	Dst.Empty(Src.Num());
+	if (!Src.Num()) return;
+	Dst.AddNoInit(Src.Num());
+	memcpy(&Dst[0], &Src[0], Src.Num() * sizeof(T));
+}
+
 
 // remove same keys from KeyQuat and KeyPos arrays
-void RemoveRedundantKeys(CAnimSet &Anim)
+int RemoveRedundantKeys(CMeshAnimSeq &Seq, int &TotalKeys)
 {
 	guard(RemoveRedundantKeys);
 
-	int numRemovedKeys = 0, numKeys = 0;		// statistics
-	for (int seq = 0; seq < Anim.Sequences.Num(); seq++)
+	int numRemovedKeys = 0;
+	for (int bone = 0; bone < Seq.Tracks.Num(); bone++)
 	{
-		// for each sequence ...
-		CMeshAnimSeq &Seq = Anim.Sequences[seq];
-		for (int bone = 0; bone < Seq.Tracks.Num(); bone++)
-		{
-			// for each bone track
-			CAnalogTrack &Track = Seq.Tracks[bone];
+		// for each bone track
+		CAnalogTrack &Track = Seq.Tracks[bone];
 
-			// ensure at least 2 keys
-			numKeys += Track.KeyQuat.Num() + Track.KeyPos.Num();
-			if (Track.KeyQuat.Num() <= 1 || Track.KeyPos.Num() <= 1 || Track.KeyTime.Num() <= 1)
-				continue;
+		// ensure at least 2 keys
+		TotalKeys += Track.KeyQuat.Num() + Track.KeyPos.Num();
+		if (Track.KeyTime.Num() <= 1)
+			continue;
 
-			int i, numKeys;
-			bool remove;
+		int i, numKeys;
+		bool remove;
 
-			// compare KeyQuat
+		// compare KeyQuat
+		numKeys = Track.KeyQuat.Num();
+		if (numKeys > 1)
+		{
 			remove = true;
 			CQuat &Q0 = Track.KeyQuat[0];
-			numKeys = Track.KeyQuat.Num();
 			for (i = 1; i < numKeys; i++)
 			{
 				CQuat &Q1 = Track.KeyQuat[i];
@@ -60,14 +67,15 @@ void RemoveRedundantKeys(CAnimSet &Anim)
 				Track.KeyQuat.Remove(1, numKeys - 1);
 				numRemovedKeys += numKeys - 1;
 			}
-			//!! note: can remove KeyPos when Anim.AnimRotationOnly==true, but:
-			//!! 1) this is unrecoverable, and should be performed manually
-			//!! 2) should be done AFTER importing and some editing of AnimSet, i.e. executed manually
-			//!! this may be done as part of key reduction with lerping
-			// compare KeyPos
+		}
+		// note: KeyPos removal when Anim.AnimRotationOnly==true is unrecoverable,
+		// so it is performed manually with StripPositionTracks()
+		// compare KeyPos (may be empty when position track was stripped)
+		numKeys = Track.KeyPos.Num();
+		if (numKeys > 1)
+		{
 			remove = true;
 			CVec3 &V0 = Track.KeyPos[0];
-			numKeys = Track.KeyPos.Num();
 			for (i = 1; i < numKeys; i++)
 			{
 				CVec3 &V1 = Track.KeyPos[i];
@@ -83,16 +91,37 @@ void RemoveRedundantKeys(CAnimSet &Anim)
 				Track.KeyPos.Remove(1, numKeys - 1);
 				numRemovedKeys += numKeys - 1;
 			}
-			if (Track.KeyQuat.Num() == 1 && Track.KeyPos.Num() == 1)
-			{
-				// position and orientation tracks are single-entry, remove unnecessary
-				// time keys for this sequence/bone
-				Track.KeyTime.Remove(1, Track.KeyTime.Num() - 1);
-			}
+		}
+		if (Track.KeyQuat.Num() <= 1 && Track.KeyPos.Num() <= 1)
+		{
+			// position and orientation tracks are single-entry, remove unnecessary
+			// time keys for this sequence/bone
+			Track.KeyTime.Remove(1, Track.KeyTime.Num() - 1);
 		}
 	}
+
+	return numRemovedKeys;
+	unguardf(("%s", *Seq.Name));
+}
+
+
+void RemoveRedundantKeys(CAnimSet &Anim)
+{
+	guard(RemoveRedundantKeys);
+
+	bool Pooled = Anim.TrackPool.Num() > 0;
+	UnpoolTracks(Anim);
+	UnpackKeyTimes(Anim);
+
+	int numRemovedKeys = 0, numKeys = 0;		// statistics
+	for (int seq = 0; seq < Anim.Sequences.Num(); seq++)
+		numRemovedKeys += RemoveRedundantKeys(Anim.Sequences[seq], numKeys);
 	appPrintf("Removed %d of %d (%.0f%%) redundant keys\n", numRemovedKeys, numKeys,
-		numRemovedKeys * 100.0f / numKeys);
+		numKeys ? numRemovedKeys * 100.0f / numKeys : 0.0f);
+
+	PackKeyTimes(Anim);
+
+	if (Pooled) PoolTracks(Anim, Anim.PoolTolerance);
 
 	unguard;
 }
@@ -137,116 +166,476 @@ static bool CanLerpKeys(CAnalogTrack &T, int key1, int key, int key2)
 //!! 1) error for rotation and position
 //!! 2) which sequences to compress
 
-void CompressAnimation(CAnimSet &Anim)
+int CompressAnimation(CMeshAnimSeq &Seq, int &TotalKeys)
 {
 	guard(CompressAnimation);
 
-	// get maximal sequence length
-	int maxSequenceLen = 0;
-	int seq;
-	for (seq = 0; seq < Anim.Sequences.Num(); seq++)
+	// get maximal track length
+	int maxTrackLen = 0;
+	int bone;
+	for (bone = 0; bone < Seq.Tracks.Num(); bone++)
 	{
-		CMeshAnimSeq &Seq = Anim.Sequences[seq];
-		for (int bone = 0; bone < Seq.Tracks.Num(); bone++)
-		{
-			int len = Seq.Tracks[bone].KeyTime.Num();
-			if (len > maxSequenceLen)
-				maxSequenceLen = len;
-		}
+		int len = Seq.Tracks[bone].KeyTime.Num();
+		if (len > maxTrackLen)
+			maxTrackLen = len;
 	}
-//	appPrintf("Maximal sequence length is %d keys\n", maxSequenceLen);
-
-	bool* removeKeyFlag = new bool[maxSequenceLen];
 
+	bool* removeKeyFlag = new bool[maxTrackLen];
 
-	int numRemovedKeys = 0, numKeys = 0;		// statistics
-	for (seq = 0; seq < Anim.Sequences.Num(); seq++)
+	int numRemovedKeys = 0;
+	for (bone = 0; bone < Seq.Tracks.Num(); bone++)
 	{
-		// for each sequence ...
-		CMeshAnimSeq &Seq = Anim.Sequences[seq];
-		for (int bone = 0; bone < Seq.Tracks.Num(); bone++)
-		{
 #if DEBUG_COMPRESS
-			int wipedTrackKeys = 0;
+		int wipedTrackKeys = 0;
 #endif
-			// for each bone track
-			CAnalogTrack &Track = Seq.Tracks[bone];
-
-			// ensure at least 3 keys
-			numKeys += Track.KeyQuat.Num() + Track.KeyPos.Num();
-			if (Track.KeyQuat.Num() < 3 && Track.KeyPos.Num() < 3)
-				continue;
-
-			int numKeys    = Track.KeyTime.Num();
-			bool checkQuat = Track.KeyQuat.Num() >= 3;
-			bool checkPos  = Track.KeyPos.Num()  >= 3;
-			assert(checkQuat  || checkPos);
-			assert(!checkQuat || Track.KeyQuat.Num() == numKeys);
-			assert(!checkPos  || Track.KeyPos.Num()  == numKeys);
-
-			removeKeyFlag[0] = removeKeyFlag[numKeys-1] = false;
-
-			int key;
-			int lastKey = 0;	// last available key
-			bool hasRemovedKeys = false;
-			for (key = 1; key < numKeys - 1; key++)
+		// for each bone track
+		CAnalogTrack &Track = Seq.Tracks[bone];
+
+		// ensure at least 3 keys
+		TotalKeys += Track.KeyQuat.Num() + Track.KeyPos.Num();
+		if (Track.KeyQuat.Num() < 3 && Track.KeyPos.Num() < 3)
+			continue;
+
+		int numKeys    = Track.KeyTime.Num();
+		bool checkQuat = Track.KeyQuat.Num() >= 3;
+		bool checkPos  = Track.KeyPos.Num()  >= 3;
+		assert(checkQuat  || checkPos);
+		assert(!checkQuat || Track.KeyQuat.Num() == numKeys);
+		assert(!checkPos  || Track.KeyPos.Num()  == numKeys);
+
+		removeKeyFlag[0] = removeKeyFlag[numKeys-1] = false;
+
+		int key;
+		int lastKey = 0;	// last available key
+		bool hasRemovedKeys = false;
+		for (key = 1; key < numKeys - 1; key++)
+		{
+			bool remove = CanLerpKeys(Track, lastKey, key, key+1);
+			if (remove)
 			{
-				bool remove = CanLerpKeys(Track, lastKey, key, key+1);
-				if (remove)
+				// can lerp current key, should check previous removed keys
+				// (their error may be increased - should not remove current
+				// key in that case)
+				for (int k = lastKey+1; k < key; k++)
 				{
-					// can lerp current key, should check previous removed keys
-					// (their error may be increased - should not remove current
-					// key in that case)
-					for (int k = lastKey+1; k < key; k++)
+					if (!CanLerpKeys(Track, lastKey, k, key+1))
 					{
-						if (!CanLerpKeys(Track, lastKey, k, key+1))
-						{
-							remove = false;
-							break;
-						}
+						remove = false;
+						break;
 					}
 				}
-				// remember decision
-				removeKeyFlag[key] = remove;
-				if (!remove)
-				{
-					lastKey = key;
-				}
-				else
-				{
-					hasRemovedKeys = true;
-					numRemovedKeys++;
+			}
+			// remember decision
+			removeKeyFlag[key] = remove;
+			if (!remove)
+			{
+				lastKey = key;
+			}
+			else
+			{
+				hasRemovedKeys = true;
+				numRemovedKeys++;
 #if DEBUG_COMPRESS
-					wipedTrackKeys++;
+				wipedTrackKeys++;
 #endif
-				}
 			}
-			// remove marked keys
-			if (hasRemovedKeys)
+		}
+		// remove marked keys
+		if (hasRemovedKeys)
+		{
+			for (key = numKeys-1; key >= 0; key--)
 			{
-				for (key = numKeys-1; key >= 0; key--)
+				if (removeKeyFlag[key])
 				{
-					if (removeKeyFlag[key])
-					{
-						Track.KeyTime.Remove(key, 1);
-						if (checkQuat)
-							Track.KeyQuat.Remove(key, 1);
-						if (checkPos)
-							Track.KeyPos.Remove(key, 1);
-					}
+					Track.KeyTime.Remove(key, 1);
+					if (checkQuat)
+						Track.KeyQuat.Remove(key, 1);
+					if (checkPos)
+						Track.KeyPos.Remove(key, 1);
 				}
 			}
+		}
 #if DEBUG_COMPRESS
-			if (wipedTrackKeys)
-				appPrintf("%s / %s[%d]: removed %d keys\n",
-					*Seq.Name, *Anim.TrackBoneName[bone].Name, bone, wipedTrackKeys);
+		if (wipedTrackKeys)
+			appPrintf("%s / track %d: removed %d keys\n", *Seq.Name, bone, wipedTrackKeys);
 #endif
-		}
 	}
-	appPrintf("Compression: removed %d of %d (%.0f%%) keys\n", numRemovedKeys, numKeys,
-		numRemovedKeys * 100.0f / numKeys);
 
 	delete removeKeyFlag;
 
+	return numRemovedKeys;
+	unguardf(("%s", *Seq.Name));
+}
+
+
+void CompressAnimation(CAnimSet &Anim)
+{
+	guard(CompressAnimation);
+
+	bool Pooled = Anim.TrackPool.Num() > 0;
+	UnpoolTracks(Anim);
+	UnpackKeyTimes(Anim);
+
+	int numRemovedKeys = 0, numKeys = 0;		// statistics
+	for (int seq = 0; seq < Anim.Sequences.Num(); seq++)
+		numRemovedKeys += CompressAnimation(Anim.Sequences[seq], numKeys);
+	appPrintf("Compression: removed %d of %d (%.0f%%) keys\n", numRemovedKeys, numKeys,
+		numKeys ? numRemovedKeys * 100.0f / numKeys : 0.0f);
+
+	PackKeyTimes(Anim);
+
+	if (Pooled) PoolTracks(Anim, Anim.PoolTolerance);
+
+	unguard;
+}
+
+
+/*-----------------------------------------------------------------------------
+	Track removal
+-----------------------------------------------------------------------------*/
+
+// find track, which will be used for mesh root bone
+static int FindRootTrack(const CAnimSet &Anim, const CSkeletalMesh *Mesh)
+{
+	if (!Mesh || !Mesh->Skeleton.Num())
+		return 0;						// assume, that AnimSet bones are sorted by hierarchy too
+	const char *RootName = Mesh->Skeleton[0].Name;
+	for (int i = 0; i < Anim.TrackBoneName.Num(); i++)
+		if (!stricmp(Anim.TrackBoneName[i].Name, RootName))
+			return i;
+	return -1;							// mesh root bone is not animated
+}
+
+
+void StripPositionTracks(CAnimSet &Anim, const CSkeletalMesh *Mesh)
+{
+	guard(StripPositionTracks);
+
+	bool Pooled = Anim.TrackPool.Num() > 0;
+	UnpoolTracks(Anim);
+	UnpackKeyTimes(Anim);
+
+	// root bone always takes translation from the animation
+	int rootTrack = FindRootTrack(Anim, Mesh);
+
+	int numRemovedKeys = 0, numKeys = 0;		// statistics
+	for (int seq = 0; seq < Anim.Sequences.Num(); seq++)
+	{
+		CMeshAnimSeq &Seq = Anim.Sequences[seq];
+		for (int bone = 0; bone < Seq.Tracks.Num(); bone++)
+		{
+			CAnalogTrack &Track = Seq.Tracks[bone];
+			numKeys += Track.KeyQuat.Num() + Track.KeyPos.Num();
+			if (bone == rootTrack)
+				continue;
+			numRemovedKeys += Track.KeyPos.Num();
+			Track.KeyPos.Empty();
+			// time keys are not needed when rotation is constant
+			if (Track.KeyQuat.Num() <= 1 && Track.KeyTime.Num() > 1)
+				Track.KeyTime.Remove(1, Track.KeyTime.Num() - 1);
+		}
+	}
+	appPrintf("Stripped %d of %d (%.0f%%) position keys\n", numRemovedKeys, numKeys,
+		numKeys ? numRemovedKeys * 100.0f / numKeys : 0.0f);
+
+	PackKeyTimes(Anim);
+
+	if (Pooled) PoolTracks(Anim, Anim.PoolTolerance);
+
+	unguard;
+}
+
+
+void RemoveUnusedTracks(CAnimSet &Anim, const CSkeletalMesh **Meshes, int NumMeshes)
+{
+	guard(RemoveUnusedTracks);
+
+	bool Pooled = Anim.TrackPool.Num() > 0;
+	UnpoolTracks(Anim);
+
+	int numRemoved = 0;
+	for (int track = Anim.TrackBoneName.Num() - 1; track >= 0; track--)
+	{
+		// find bone in target meshes
+		const char *BoneName = Anim.TrackBoneName[track].Name;
+		int mesh;
+		for (mesh = 0; mesh < NumMeshes; mesh++)
+			if (Meshes[mesh]->FindBone(BoneName) >= 0)
+				break;
+		if (mesh < NumMeshes)
+			continue;					// bone is used
+		// remove track from all sequences
+		for (int seq = 0; seq < Anim.Sequences.Num(); seq++)
+		{
+			CMeshAnimSeq &Seq = Anim.Sequences[seq];
+			assert(Seq.Tracks.Num() == Anim.TrackBoneName.Num());
+			Seq.Tracks.Remove(track);
+		}
+		Anim.TrackBoneName.Remove(track);
+		numRemoved++;
+	}
+	appPrintf("Removed %d tracks of unused bones\n", numRemoved);
+
+	if (Pooled) PoolTracks(Anim, Anim.PoolTolerance);
+
+	unguard;
+}
+
+
+/*-----------------------------------------------------------------------------
+	Track pooling
+-----------------------------------------------------------------------------*/
+
+#define POOL_HASH_SIZE		4096
+
+static bool FloatsSame(const float *A, const float *B, int Count, float Tolerance)
+{
+	for (int i = 0; i < Count; i++)
+		if (fabs(A[i] - B[i]) > Tolerance)
+			return false;
+	return true;
+}
+
+
+static bool TracksSame(const CAnalogTrack &A, const CAnalogTrack &B, float Tolerance)
+{
+	if (A.KeyQuat.Num()    != B.KeyQuat.Num()    ||
+		A.KeyPos.Num()     != B.KeyPos.Num()     ||
+		A.KeyScale.Num()   != B.KeyScale.Num()   ||
+		A.KeyTime.Num()    != B.KeyTime.Num()    ||
+		A.KeyFrame8.Num()  != B.KeyFrame8.Num()  ||
+		A.KeyFrame16.Num() != B.KeyFrame16.Num())
+		return false;
+	// key times should match exactly
+	int NumKeys = A.GetNumKeys();
+	for (int i = 0; i < NumKeys; i++)
+		if (A.GetKeyTime(i) != B.GetKeyTime(i))
+			return false;
+	if (A.KeyQuat.Num() && !FloatsSame(&A.KeyQuat[0].x, &B.KeyQuat[0].x, A.KeyQuat.Num() * 4, Tolerance))
+		return false;
+	if (A.KeyPos.Num() && !FloatsSame(A.KeyPos[0].v, B.KeyPos[0].v, A.KeyPos.Num() * 3, Tolerance))
+		return false;
+	if (A.KeyScale.Num() && !FloatsSame(A.KeyScale[0].v, B.KeyScale[0].v, A.KeyScale.Num() * 3, Tolerance))
+		return false;
+	return true;
+}
+
+
+static unsigned HashFloats(unsigned Hash, const float *Data, int Count, float Step)
+{
+	for (int i = 0; i < Count; i++)
+	{
+		int q = appFloor(Data[i] / Step);
+		Hash = (Hash ^ q) * 16777619;
+	}
+	return Hash;
+}
+
+
+// Hash of quantized track data. Quantization step is larger than pooling tolerance,
+// so tracks within tolerance will get the same hash in most cases; rare misses are
+// only reducing pooling efficiency.
+static int GetTrackHash(const CAnalogTrack &T, float Tolerance)
+{
+	float Step = max(Tolerance, 1e-5f) * 16;
+	unsigned Hash = 2166136261u;
+	Hash = (Hash ^ T.KeyQuat.Num())  * 16777619;
+	Hash = (Hash ^ T.KeyPos.Num())   * 16777619;
+	Hash = (Hash ^ T.GetNumKeys())   * 16777619;
+	if (T.KeyQuat.Num())  Hash = HashFloats(Hash, &T.KeyQuat[0].x, T.KeyQuat.Num() * 4, Step);
+	if (T.KeyPos.Num())   Hash = HashFloats(Hash, T.KeyPos[0].v, T.KeyPos.Num() * 3, Step);
+	if (T.KeyScale.Num()) Hash = HashFloats(Hash, T.KeyScale[0].v, T.KeyScale.Num() * 3, Step);
+	return (Hash ^ (Hash >> 16)) & (POOL_HASH_SIZE - 1);
+}
+
+
+void PoolTracks(CAnimSet &Anim, float Tolerance)
+{
+	guard(PoolTracks);
+
+	Anim.LoadAllSequences();
+	UnpoolTracks(Anim);
+	Anim.PoolTolerance = Tolerance;
+
+	int HashHead[POOL_HASH_SIZE];
+	memset(HashHead, -1, sizeof(HashHead));
+	TArray<int> HashNext;
+
+	TArray<CAnalogTrack> &Pool = Anim.TrackPool;
+	int numTracks = 0, sizeBefore = 0, sizeAfter = 0;		// statistics
+	for (int seq = 0; seq < Anim.Sequences.Num(); seq++)
+	{
+		CMeshAnimSeq &Seq = Anim.Sequences[seq];
+		int NumTracks = Seq.Tracks.Num();
+		Seq.TrackRefs.Empty(NumTracks);
+		Seq.TrackRefs.Add(NumTracks);
+		for (int track = 0; track < NumTracks; track++)
+		{
+			CAnalogTrack &Track = Seq.Tracks[track];
+			int size = sizeof(CAnalogTrack) + Track.GetKeysSize();
+			sizeBefore += size;
+			numTracks++;
+			// find the same track in pool
+			int hash = GetTrackHash(Track, Tolerance);
+			int index;
+			for (index = HashHead[hash]; index >= 0; index = HashNext[index])
+				if (TracksSame(Pool[index], Track, Tolerance))
+					break;
+			if (index < 0)
+			{
+				// move track to pool; Tracks array has only memory-relocatable data
+				index = Pool.Add();
+				memcpy(&Pool[index], &Track, sizeof(CAnalogTrack));
+				memset(&Track, 0, sizeof(CAnalogTrack));
+				HashNext.AddItem(HashHead[hash]);
+				HashHead[hash] = index;
+				sizeAfter += size;
+			}
+			Seq.TrackRefs[track] = index;
+			sizeAfter += sizeof(int);
+		}
+		Seq.Tracks.Remove(0, NumTracks);
+		Seq.Tracks.Empty();
+	}
+	Anim.LinkTrackPool();
+
+	appPrintf("Pooled %d tracks to %d shared tracks, saved %d of %d bytes (%.0f%%)\n",
+		numTracks, Pool.Num(), sizeBefore - sizeAfter, sizeBefore,
+		sizeBefore ? (sizeBefore - sizeAfter) * 100.0f / sizeBefore : 0.0f);
+
+	unguard;
+}
+
+
+void UnpoolTracks(CAnimSet &Anim)
+{
+	if (!Anim.TrackPool.Num()) return;
+
+	guard(UnpoolTracks);
+
+	Anim.LoadAllSequences();
+	for (int seq = 0; seq < Anim.Sequences.Num(); seq++)
+	{
+		CMeshAnimSeq &Seq = Anim.Sequences[seq];
+		int NumTracks = Seq.TrackRefs.Num();
+		if (!NumTracks) continue;
+		Seq.Tracks.Empty(NumTracks);
+		Seq.Tracks.Add(NumTracks);
+		for (int track = 0; track < NumTracks; track++)
+		{
+			const CAnalogTrack &Src = Anim.TrackPool[Seq.TrackRefs[track]];
+			CAnalogTrack &Dst = Seq.Tracks[track];
+			CopyArray(Dst.KeyQuat,  Src.KeyQuat);
+			CopyArray(Dst.KeyPos,   Src.KeyPos);
+			CopyArray(Dst.KeyScale, Src.KeyScale);
+			CopyArray(Dst.KeyTime,  Src.KeyTime);
+			CopyArray(Dst.KeyFrame8,  Src.KeyFrame8);
+			CopyArray(Dst.KeyFrame16, Src.KeyFrame16);
+			Dst.KeyStep = Src.KeyStep;
+		}
+		Seq.TrackRefs.Empty();
+	}
+	Anim.TrackPool.Remove(0, Anim.TrackPool.Num());
+	Anim.TrackPool.Empty();
+	Anim.LinkTrackPool();
+
+	unguard;
+}
+
+
+/*-----------------------------------------------------------------------------
+	Key time packing
+-----------------------------------------------------------------------------*/
+
+static void PackTrackTimes(CAnalogTrack &T)
+{
+	int NumKeys = T.KeyTime.Num();
+	if (!NumKeys) return;				// already packed
+	int i;
+
+	// check for uniform key placement
+	float Step = (NumKeys > 1) ? T.KeyTime[1] : 1;
+	bool Uniform = (T.KeyTime[0] == 0) && (Step > 0);
+	for (i = 1; i < NumKeys && Uniform; i++)
+		if (T.KeyTime[i] != i * Step)
+			Uniform = false;
+	if (Uniform && NumKeys == max(T.KeyQuat.Num(), T.KeyPos.Num()))
+	{
+		T.KeyStep = Step;
+		T.KeyTime.Empty();
+		return;
+	}
+
+	// check for integer frame times
+	float MaxTime = 0;
+	for (i = 0; i < NumKeys; i++)
+	{
+		float Time = T.KeyTime[i];
+		if (Time < 0 || Time != appFloor(Time))
+			return;						// keep float times
+		MaxTime = max(MaxTime, Time);
+	}
+	if (MaxTime < 256)
+	{
+		T.KeyFrame8.Add(NumKeys);
+		for (i = 0; i < NumKeys; i++)
+			T.KeyFrame8[i] = (byte)T.KeyTime[i];
+	}
+	else if (MaxTime < 65536)
+	{
+		T.KeyFrame16.Add(NumKeys);
+		for (i = 0; i < NumKeys; i++)
+			T.KeyFrame16[i] = (word)T.KeyTime[i];
+	}
+	else
+		return;
+	T.KeyTime.Empty();
+}
+
+
+static void UnpackTrackTimes(CAnalogTrack &T)
+{
+	if (T.KeyTime.Num()) return;		// not packed
+	int NumKeys = T.GetNumKeys();
+	TArray<float> Times;
+	Times.Add(NumKeys);
+	for (int i = 0; i < NumKeys; i++)
+		Times[i] = T.GetKeyTime(i);
+	CopyArray(T.KeyTime, Times);
+	T.KeyFrame8.Empty();
+	T.KeyFrame16.Empty();
+	T.KeyStep = 0;
+}
+
+
+void PackKeyTimes(CMeshAnimSeq &Seq)
+{
+	for (int bone = 0; bone < Seq.Tracks.Num(); bone++)
+		PackTrackTimes(Seq.Tracks[bone]);
+}
+
+
+void PackKeyTimes(CAnimSet &Anim)
+{
+	guard(PackKeyTimes);
+
+	for (int seq = 0; seq < Anim.Sequences.Num(); seq++)
+		PackKeyTimes(Anim.Sequences[seq]);
+
+	unguard;
+}
+
+
+void UnpackKeyTimes(CAnimSet &Anim)
+{
+	guard(UnpackKeyTimes);
+
+	for (int seq = 0; seq < Anim.Sequences.Num(); seq++)
+	{
+		CMeshAnimSeq &Seq = Anim.Sequences[seq];
+		for (int bone = 0; bone < Seq.Tracks.Num(); bone++)
+			UnpackTrackTimes(Seq.Tracks[bone]);
+	}
+
 	unguard;
 }
@@ -5,5 +5,40 @@
 void RemoveRedundantKeys(CAnimSet &Anim);
 void CompressAnimation(CAnimSet &Anim);
 
+// Per-sequence versions of functions above, may be called for different sequences in
+// parallel. Sequence tracks should be unpooled and have unpacked key times. Returns
+// number of removed keys, number of processed keys is added to TotalKeys.
+int RemoveRedundantKeys(CMeshAnimSeq &Seq, int &TotalKeys);
+int CompressAnimation(CMeshAnimSeq &Seq, int &TotalKeys);
+
+/*
+ *	Removing tracks
+ */
+// remove position keys from all tracks except mesh root; bone position will be taken
+// from the mesh reference pose; when Mesh is NULL, track 0 is considered as root
+void StripPositionTracks(CAnimSet &Anim, const CSkeletalMesh *Mesh = NULL);
+// remove tracks for bones, which are not present in any of Meshes
+void RemoveUnusedTracks(CAnimSet &Anim, const CSkeletalMesh **Meshes, int NumMeshes);
+
+/*
+ *	Track pooling
+ */
+// store identical tracks (keys within Tolerance) of all sequences once in AnimSet
+// track pool; sequences will reference pooled tracks by index
+void PoolTracks(CAnimSet &Anim, float Tolerance = 0);
+// restore own tracks for all sequences; used before any track modification. Functions
+// above are pooling tracks again after modification, with Anim.PoolTolerance.
+void UnpoolTracks(CAnimSet &Anim);
+
+/*
+ *	Key time packing
+ */
+// replace float KeyTime arrays with uniform key step (when possible) or compact 8/16-bit
+// frame numbers; called by all track modification functions
+void PackKeyTimes(CAnimSet &Anim);
+void PackKeyTimes(CMeshAnimSeq &Seq);
+// restore float KeyTime arrays for all tracks
+void UnpackKeyTimes(CAnimSet &Anim);
+
 
 #endif // __ANIMCOMPRESSION_H__
@@ -58,3 +58,8 @@ var(Colors) Color3f MeshBackground2;
  * Enable gradient for background
  */
 var(Colors) bool EnableGradient;
+/**
+ * Compress saved mesh and animation files. Compressed AnimSet
+ * could not be loaded partially.
+ */
+var(Files) bool CompressFiles;
@@ -79,6 +79,11 @@ public:
 	 * Enable gradient for background
 	 */
 	bool						EnableGradient;
+	/**
+	 * Compress saved mesh and animation files. Compressed AnimSet
+	 * could not be loaded partially.
+	 */
+	bool						CompressFiles;
 };
 
 
@@ -90,4 +95,11 @@ public:
 	REGISTER_CLASS(CAppSettings)
 
 
+/*-----------------------------------------------------------------------------
+	Static typeinfo
+-----------------------------------------------------------------------------*/
+
+#define EDITOR_TYPEINFO_TABLE
+
+
 #endif // __EDITORCLASSES_H__
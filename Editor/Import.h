@@ -2,11 +2,70 @@
 #define __IMPORT_H__
 
 
+/*
+ *	Import diagnostics
+ *	Source assets may produce the same warning for every vertex or key. Importers
+ *	count warnings by category and keep only a few first examples; the summary is
+ *	printed once, at the end of import.
+ */
+#define MAX_IMPORT_EXAMPLES		4
+
+enum EImportWarning
+{
+	IW_UnusedMaterial,
+	IW_WrongIndexCount,
+	IW_TooMuchInfluences,
+	IW_ZeroWeight,
+	IW_RedundantInfluences,
+	IW_WrongKeyTime,
+	IW_ExtraBytes,
+	IW_WrongKeyCount,
+
+	IW_Count
+};
+
+struct CImportWarning
+{
+	volatile int	Count;
+	TString<128>	Examples[MAX_IMPORT_EXAMPLES];
+
+	inline int NumExamples() const
+	{
+		return min(Count, MAX_IMPORT_EXAMPLES);
+	}
+};
+
+class CImportLog
+{
+public:
+	CImportWarning	Warnings[IW_Count];
+
+	CImportLog()
+	{
+		Reset();
+	}
+	void Reset();
+	// register a warning; may be called from multiple threads; message is formatted
+	// only for the first MAX_IMPORT_EXAMPLES warnings of each category
+	void Add(EImportWarning Type, const char *fmt, ...);
+	int GetCount(EImportWarning Type) const
+	{
+		return Warnings[Type].Count;
+	}
+	int GetTotalCount() const;
+	// print table of warnings with examples
+	void WriteTable(COutputDevice &Out) const;
+	// send summary to appNotify(), when there were any warnings
+	void Report() const;
+};
+
 /*
  *	Importing external content
+ *	Warnings are reported with appNotify() at the end of import; when Log is not NULL,
+ *	they are also returned to the caller.
  */
-void ImportPsk(CArchive &Ar, CSkeletalMesh &Mesh);
-void ImportPsa(CArchive &Ar, CAnimSet &Anim);
+void ImportPsk(CArchive &Ar, CSkeletalMesh &Mesh, CImportLog *Log = NULL);
+void ImportPsa(CArchive &Ar, CAnimSet &Anim, CImportLog *Log = NULL);
 
 /*
  *	Utility functions
@@ -1,4 +1,5 @@
 #include "Core.h"
+#include "OutputDeviceMem.h"
 
 #include "AnimClasses.h"
 #include "Import.h"
@@ -10,6 +11,14 @@
 // all, so we should use fixed timestep of 1.0
 #define FIXED_FRAME_TIME			1
 
+// Number of threads for building animation sequences; 0 = number of CPU cores, 1 = serial
+// import. Result does not depend on this value.
+#define IMPORT_THREADS				0
+
+// block size for transposing PSA keys to bone tracks
+#define TRANSPOSE_FRAMES			64
+#define TRANSPOSE_BONES				16
+
 
 /*-----------------------------------------------------------------------------
 	Temporaty structures
@@ -29,11 +38,84 @@ struct CVertexWeights
 #define MIN_VERTEX_INFLUENCE		(1.0f / 255)	// will be converted to bytes in renderer ...
 
 
+/*-----------------------------------------------------------------------------
+	Import diagnostics
+-----------------------------------------------------------------------------*/
+
+static const char *WarningNames[IW_Count] =
+{
+	"unused material",
+	"wrong mesh index count",
+	"vertex has too much influences, reduced",
+	"vertex has total weight equals to 0, replaced with 1",
+	"vertex has redundant influences, cut",
+	"incorrect key time",
+	"extra bytes in source file",
+	"number of imported keys differs from source",
+};
+
+
+void CImportLog::Reset()
+{
+	for (int i = 0; i < IW_Count; i++)
+		Warnings[i].Count = 0;
+}
+
+
+void CImportLog::Add(EImportWarning Type, const char *fmt, ...)
+{
+	CImportWarning &W = Warnings[Type];
+	int Index = appInterlockedAdd(&W.Count, 1);
+	if (Index >= MAX_IMPORT_EXAMPLES) return;	// counting only
+	va_list	argptr;
+	va_start(argptr, fmt);
+	vsnprintf(*W.Examples[Index], sizeof(W.Examples[Index]), fmt, argptr);
+	va_end(argptr);
+}
+
+
+int CImportLog::GetTotalCount() const
+{
+	int Count = 0;
+	for (int i = 0; i < IW_Count; i++)
+		Count += Warnings[i].Count;
+	return Count;
+}
+
+
+void CImportLog::WriteTable(COutputDevice &Out) const
+{
+	Out.Printf("%8s  %s\n", "count", "warning");
+	for (int i = 0; i < IW_Count; i++)
+	{
+		const CImportWarning &W = Warnings[i];
+		if (!W.Count) continue;
+		Out.Printf("%8d  %s\n", W.Count, WarningNames[i]);
+		for (int j = 0; j < W.NumExamples(); j++)
+			Out.Printf("%10s%s\n", "", *W.Examples[j]);
+		if (W.Count > MAX_IMPORT_EXAMPLES)
+			Out.Printf("%10s...\n", "");
+	}
+}
+
+
+void CImportLog::Report() const
+{
+	guard(CImportLog::Report);
+	if (!GetTotalCount()) return;
+	COutputDeviceMem Mem(16384);
+	WriteTable(Mem);
+	appNotify("Import warnings:\n%s", Mem.GetText());
+	unguard;
+}
+
+
 /*-----------------------------------------------------------------------------
 	Sorting bones by hierarchy
 -----------------------------------------------------------------------------*/
 
 static const CMeshBone* bonesToSort;
+static int numBonesToSort;
 
 static int SortBones(const int *_B1, const int *_B2)
 {
@@ -41,7 +123,8 @@ static int SortBones(const int *_B1, const int *_B2)
 	B[0] = *_B1;
 	B[1] = *_B2;
 
-	int BoneTree[MAX_MESH_BONES][2];
+	CScratchScope Scratch;
+	int (*BoneTree)[2] = NewScratch<int[2]>(numBonesToSort);
 	int BoneLeaf[2];
 
 //	appNotify("compare %d and %d", B[0], B[1]);
@@ -58,7 +141,7 @@ static int SortBones(const int *_B1, const int *_B2)
 		{
 //			appNotify("    %d", BoneIndex);
 			BoneTree[Leaf++][i] = BoneIndex;
-			if (Leaf >= MAX_MESH_BONES)
+			if (Leaf >= numBonesToSort)
 				appError("Recursion in skeleton hierarchy found");
 		}
 		BoneLeaf[i] = Leaf;
@@ -122,8 +205,9 @@ static void ComputeMeshBoxes(CSkeletalMesh &Mesh, CCoords *boxes, bool *boxValid
 	int numBones = Mesh.Skeleton.Num();
 
 	// prepare bone bounds and refpose coords
-	CBox	bounds[MAX_MESH_BONES];		// bounds in local coordinate system
-	CCoords	coords[MAX_MESH_BONES];		// local coordinate system
+	CScratchScope Scratch;
+	CBox	*bounds = NewScratch<CBox>(numBones);		// bounds in local coordinate system
+	CCoords	*coords = NewScratch<CCoords>(numBones);	// local coordinate system
 	for (boneIdx = 0; boneIdx < numBones; boneIdx++)
 	{
 		const CMeshBone &B = Mesh.Skeleton[boneIdx];
@@ -189,8 +273,9 @@ void GenerateBoxes(CSkeletalMesh &Mesh)
 {
 	guard(GenerateBoxes);
 
-	CCoords boxes[MAX_MESH_BONES];
-	bool    boxValid[MAX_MESH_BONES];
+	CScratchScope Scratch;
+	CCoords *boxes    = NewScratch<CCoords>(Mesh.Skeleton.Num());
+	bool    *boxValid = NewScratch<bool>(Mesh.Skeleton.Num());
 	ComputeMeshBoxes(Mesh, boxes, boxValid);
 
 	for (int boneIdx = 0; boneIdx < Mesh.Skeleton.Num(); boneIdx++)
@@ -211,8 +296,9 @@ void GenerateBoxes(CSkeletalMesh &Mesh)
 bool GenerateBox(CSkeletalMesh &Mesh, int BoneIndex, CCoords &Box)
 {
 	guard(GenerateBox);
-	CCoords boxes[MAX_MESH_BONES];
-	bool    boxValid[MAX_MESH_BONES];
+	CScratchScope Scratch;
+	CCoords *boxes    = NewScratch<CCoords>(Mesh.Skeleton.Num());
+	bool    *boxValid = NewScratch<bool>(Mesh.Skeleton.Num());
 	ComputeMeshBoxes(Mesh, boxes, boxValid);
 	if (boxValid[BoneIndex])
 	{
@@ -224,11 +310,16 @@ bool GenerateBox(CSkeletalMesh &Mesh, int BoneIndex, CCoords &Box)
 }
 
 
-void ImportPsk(CArchive &Ar, CSkeletalMesh &Mesh)
+void ImportPsk(CArchive &Ar, CSkeletalMesh &Mesh, CImportLog *Log)
 {
 	guard(ImportPsk);
+	MEM_TAG(MEM_Mesh);
 	int i, j;
 
+	CImportLog LocalLog;
+	if (!Log) Log = &LocalLog;
+	Log->Reset();
+
 	/*---------------------------------
 	 *	Load PSK file
 	 *-------------------------------*/
@@ -267,19 +358,18 @@ void ImportPsk(CArchive &Ar, CSkeletalMesh &Mesh)
 		{
 			numVerts = Chunk.DataCount;
 			Verts.Empty(numVerts);
-			Verts.Add(numVerts);
-			for (i = 0; i < numVerts; i++)
-				Ar << Verts[i];
+			Verts.AddNoInit(numVerts);
+			Verts.SerializeItems(Ar);
 		}
 		else if (CHUNK("VTXW0000"))
 		{
 			numWedges = Chunk.DataCount;
 			Wedges.Empty(numWedges);
-			Wedges.Add(numWedges);
-			for (i = 0; i < numWedges; i++)
+			Wedges.AddNoInit(numWedges);
+			Wedges.SerializeItems(Ar);
+			if (numVerts <= 65536)
 			{
-				Ar << Wedges[i];
-				if (numVerts <= 65536)
+				for (i = 0; i < numWedges; i++)
 					Wedges[i].PointIndex &= 0xFFFF;
 			}
 		}
@@ -288,8 +378,21 @@ void ImportPsk(CArchive &Ar, CSkeletalMesh &Mesh)
 			numTris = Chunk.DataCount;
 			Tris.Empty(numTris);
 			Tris.Add(numTris);
+			// load 16-bit triangles with a single read, then expand them
+			TArray<VTriangle16> Tris16;
+			Tris16.AddNoInit(numTris);
+			Tris16.SerializeItems(Ar);
 			for (i = 0; i < numTris; i++)
-				SerializeTriangle16(Ar, Tris[i]);
+			{
+				const VTriangle16 &S = Tris16[i];
+				VTriangle32 &D = Tris[i];
+				D.WedgeIndex[0]   = S.WedgeIndex[0];
+				D.WedgeIndex[1]   = S.WedgeIndex[1];
+				D.WedgeIndex[2]   = S.WedgeIndex[2];
+				D.MatIndex        = S.MatIndex;
+				D.AuxMatIndex     = S.AuxMatIndex;
+				D.SmoothingGroups = S.SmoothingGroups;
+			}
 		}
 		else if (CHUNK("FACE3200"))	// pskx
 		{
@@ -304,17 +407,15 @@ void ImportPsk(CArchive &Ar, CSkeletalMesh &Mesh)
 			// materials are not used
 			numMaterials = Chunk.DataCount;
 			Materials.Empty(numMaterials);
-			Materials.Add(numMaterials);
-			for (i = 0; i < numMaterials; i++)
-				Ar << Materials[i];
+			Materials.AddNoInit(numMaterials);
+			Materials.SerializeItems(Ar);
 		}
 		else if (CHUNK("REFSKELT"))
 		{
 			numBones = Chunk.DataCount;
 			Bones.Empty(numBones);
-			Bones.Add(numBones);
-			for (i = 0; i < numBones; i++)
-				Ar << Bones[i];
+			Bones.AddNoInit(numBones);
+			Bones.SerializeItems(Ar);
 			if (numBones > MAX_MESH_BONES)
 				appError("Mesh has too much bones (%d)", numBones);
 		}
@@ -322,9 +423,8 @@ void ImportPsk(CArchive &Ar, CSkeletalMesh &Mesh)
 		{
 			numSrcInfs = Chunk.DataCount;
 			Infs.Empty(numSrcInfs);
-			Infs.Add(numSrcInfs);
-			for (i = 0; i < numSrcInfs; i++)
-				Ar << Infs[i];
+			Infs.AddNoInit(numSrcInfs);
+			Infs.SerializeItems(Ar);
 		}
 		else
 		{
@@ -396,7 +496,7 @@ void ImportPsk(CArchive &Ar, CSkeletalMesh &Mesh)
 	{
 		if (!matUsed[i])
 		{
-			appNotify("Unused material found: %s", Materials[i].MaterialName);
+			Log->Add(IW_UnusedMaterial, "%s", Materials[i].MaterialName);
 			continue;
 		}
 		matRemap[i] = numUsedMaterials++;
@@ -441,7 +541,7 @@ void ImportPsk(CArchive &Ar, CSkeletalMesh &Mesh)
 	}
 	assert(section == numUsedMaterials);
 	if (Lod.Indices.Num() != numTris * 3)
-		appNotify("WARNING: indices array size incorrect: %d instead of %d", Lod.Indices.Num(), numTris * 3);
+		Log->Add(IW_WrongIndexCount, "%d instead of %d", Lod.Indices.Num(), numTris * 3);
 	unguard;
 
 	// import skeleton
@@ -460,10 +560,12 @@ void ImportPsk(CArchive &Ar, CSkeletalMesh &Mesh)
 	}
 	// sort bones by hierarchy
 	//!! should remap weights, if it is possible to resort bones (or remove unused bones)
-	int sortedBones[MAX_MESH_BONES];
+	CScratchScope Scratch;
+	int *sortedBones = NewScratch<int>(numBones);
 	for (i = 0; i < numBones; i++)
 		sortedBones[i] = i;
-	bonesToSort = &Mesh.Skeleton[0];
+	bonesToSort    = &Mesh.Skeleton[0];
+	numBonesToSort = numBones;
 	QSort(sortedBones+1, numBones - 1, SortBones);
 	for (i = 0; i < numBones; i++)
 		if (sortedBones[i] != i)
@@ -504,7 +606,7 @@ void ImportPsk(CArchive &Ar, CSkeletalMesh &Mesh)
 		}
 		if (numInfs > MAX_VERTEX_INFLUENCES)
 		{
-			appNotify("Vertex %d has too much influences (%d). Reducing.", i, numInfs);
+			Log->Add(IW_TooMuchInfluences, "vertex %d: %d influences", i, numInfs);
 			numInfs = MAX_VERTEX_INFLUENCES;
 		}
 		// compute total weight
@@ -514,7 +616,7 @@ void ImportPsk(CArchive &Ar, CSkeletalMesh &Mesh)
 		// check for zero influence
 		if (totalWeight == 0)
 		{
-			appNotify("Vertex %d has total weight equals to 0, replacing with 1", i);
+			Log->Add(IW_ZeroWeight, "vertex %d", i);
 			float v = 1.0f / numInfs;
 			for (j = 0; j < numInfs; j++)
 				W[j].Weight = v;
@@ -535,7 +637,7 @@ void ImportPsk(CArchive &Ar, CSkeletalMesh &Mesh)
 		}
 		if (j != numInfs)
 		{
-			appPrintf("Vertex %d: cutting %d redundant influences\n", i, numInfs - j);
+			Log->Add(IW_RedundantInfluences, "vertex %d: cutting %d influences", i, numInfs - j);
 			numInfs = j;					// trim influences
 			assert(numInfs);
 			scale = 1.0f / totalWeight;		// should rescale influences again
@@ -620,6 +722,8 @@ void ImportPsk(CArchive &Ar, CSkeletalMesh &Mesh)
 
 	GenerateBoxes(Mesh);
 
+	Log->Report();
+
 	unguard;
 }
 
@@ -634,10 +738,112 @@ void ImportPsk(CArchive &Ar, CSkeletalMesh &Mesh)
 	Importing PSA animations
 -----------------------------------------------------------------------------*/
 
-void ImportPsa(CArchive &Ar, CAnimSet &Anim)
+struct CPsaImportContext
+{
+	CAnimSet			*Anim;
+	const AnimInfoBinary *AnimInfo;
+	const VQuatAnimKey	*Keys;
+	int					NumBones;
+	TArray<int>			Stats;			// 4 counters per sequence
+	CImportLog			*Log;
+};
+
+
+// Build and reduce tracks for a single sequence; called from multiple threads
+static void ImportPsaSequence(int Index, void *Param)
+{
+	guard(ImportPsaSequence);
+
+	CPsaImportContext &Ctx = *(CPsaImportContext*)Param;
+	const AnimInfoBinary &Src = Ctx.AnimInfo[Index];
+	CMeshAnimSeq &A = Ctx.Anim->Sequences[Index];
+	int numBones  = Ctx.NumBones;
+	int numFrames = Src.NumRawFrames;
+	int j, k;
+
+	// prepare bone tracks
+	A.Tracks.Empty(numBones);
+	A.Tracks.Add(numBones);
+	for (k = 0; k < numBones; k++)
+	{
+		CAnalogTrack &T = A.Tracks[k];
+		T.KeyQuat.Empty(numFrames);
+		T.KeyQuat.Add  (numFrames);
+		T.KeyPos .Empty(numFrames);
+		T.KeyPos .Add  (numFrames);
+		T.KeyTime.Empty(numFrames);
+		T.KeyTime.Add  (numFrames);
+	}
+
+	// copy keys; source keys are stored as [frame][bone], transpose them to
+	// [bone][frame] by blocks to keep both sides in cache
+	const VQuatAnimKey *SrcKeys = Ctx.Keys + Src.FirstRawFrame * numBones;
+	for (int f0 = 0; f0 < numFrames; f0 += TRANSPOSE_FRAMES)
+	{
+		int f1 = min(f0 + TRANSPOSE_FRAMES, numFrames);
+		for (int b0 = 0; b0 < numBones; b0 += TRANSPOSE_BONES)
+		{
+			int b1 = min(b0 + TRANSPOSE_BONES, numBones);
+			for (k = b0; k < b1; k++)
+			{
+				CAnalogTrack &T = A.Tracks[k];
+				CQuat *DstQuat = &T.KeyQuat[0];
+				CVec3 *DstPos  = &T.KeyPos[0];
+				const VQuatAnimKey *SrcKey = SrcKeys + f0 * numBones + k;
+				for (j = f0; j < f1; j++, SrcKey += numBones)
+				{
+					DstQuat[j] = SrcKey->Orientation;
+					DstPos [j] = SrcKey->Position;
+				}
+			}
+		}
+	}
+
+	// fill key times
+#if !FIXED_FRAME_TIME
+	float Time = 0;
+	for (j = 0; j < numFrames; j++)
+	{
+		const VQuatAnimKey *SrcKey = SrcKeys + j * numBones;
+		float frameTime = SrcKey->Time;
+		for (k = 0; k < numBones; k++, SrcKey++)
+		{
+			A.Tracks[k].KeyTime[j] = Time;
+			// check: all bones in single key should have save time interval
+			if (frameTime != SrcKey->Time)
+				Ctx.Log->Add(IW_WrongKeyTime, "Anim(%s): bone %s, key %d: %g != %g",
+					*A.Name, *Ctx.Anim->TrackBoneName[k].Name, j, SrcKey->Time, frameTime);
+		}
+		Time += frameTime;
+	}
+#else
+	for (k = 0; k < numBones; k++)
+	{
+		float *DstTime = numFrames ? &A.Tracks[k].KeyTime[0] : NULL;
+		for (j = 0; j < numFrames; j++)
+			DstTime[j] = j;		// equals to frame number
+	}
+#endif
+
+	// reduce keys
+	int *Stats = &Ctx.Stats[Index * 4];
+	Stats[0] = RemoveRedundantKeys(A, Stats[1]);
+	Stats[2] = CompressAnimation(A, Stats[3]);		//!! SHOULD BE CALLED FROM UI
+	PackKeyTimes(A);
+
+	unguardf(("%d", Index));
+}
+
+
+void ImportPsa(CArchive &Ar, CAnimSet &Anim, CImportLog *Log)
 {
 	guard(ImportPsa);
-	int i, j, k;
+	MEM_TAG(MEM_Anim);
+	int i;
+
+	CImportLog LocalLog;
+	if (!Log) Log = &LocalLog;
+	Log->Reset();
 
 	/*---------------------------------
 	 *	Load PSA file
@@ -647,6 +853,7 @@ void ImportPsa(CArchive &Ar, CAnimSet &Anim)
 	TArray<FNamedBoneBinary>	Bones;
 	TArray<AnimInfoBinary>		AnimInfo;
 	TArray<VQuatAnimKey>		Keys;
+	const VQuatAnimKey			*KeyData = NULL;
 
 	// load primary header
 	LOAD_CHUNK(MainHdr, "ANIMHEAD");
@@ -657,24 +864,24 @@ void ImportPsa(CArchive &Ar, CAnimSet &Anim)
 	int numBones = BoneHdr.DataCount;
 	Bones.Empty(numBones);
 	Bones.Add(numBones);
-	for (i = 0; i < numBones; i++)
-		Ar << Bones[i];
+	Bones.SerializeItems(Ar);
 
 	LOAD_CHUNK(AnimHdr, "ANIMINFO");
 	int numAnims = AnimHdr.DataCount;
 	AnimInfo.Empty(numAnims);
 	AnimInfo.Add(numAnims);
-	for (i = 0; i < numAnims; i++)
-		Ar << AnimInfo[i];
+	AnimInfo.SerializeItems(Ar);
 
 	LOAD_CHUNK(KeyHdr, "ANIMKEYS");
 	int numKeys = KeyHdr.DataCount;
-	Keys.Empty(numKeys);
-	Keys.Add(numKeys);
-	for (i = 0; i < numKeys; i++)
+	// when VQuatAnimKey has the same layout in memory and on disk, use keys in place
+	if (TTypeInfo<VQuatAnimKey>::IsPod && numKeys)
+		KeyData = (const VQuatAnimKey*)Ar.View((size_t)numKeys * sizeof(VQuatAnimKey));
+	if (!KeyData && numKeys)
 	{
-		VQuatAnimKey &K = Keys[i];
-		Ar << K;
+		Keys.Add(numKeys);
+		Keys.SerializeItems(Ar);
+		KeyData = &Keys[0];
 	}
 
 	if (!Ar.IsEof())
@@ -682,7 +889,7 @@ void ImportPsa(CArchive &Ar, CAnimSet &Anim)
 		// new PSA format have undocumented SCALEKEYS chunk
 		LOAD_CHUNK(UnkHdr, "SCALEKEYS");
 		if (!Ar.IsEof())
-			appNotify("WARNING: extra bytes in source file (position %X)", Ar.ArPos);
+			Log->Add(IW_ExtraBytes, "position %X", Ar.ArPos);
 	}
 
 	/*---------------------------------
@@ -715,60 +922,36 @@ void ImportPsa(CArchive &Ar, CAnimSet &Anim)
 		A.Rate      = Src.AnimRate;
 		A.NumFrames = Src.NumRawFrames;
 		assert(Src.TotalBones == numBones);
-
-		// prepare bone tracks
-		guard(ImportKeys);
-		A.Tracks.Empty(numBones);
-		A.Tracks.Add(numBones);
-		// prepare analog track
-		for (j = 0; j < numBones; j++)
-		{
-			CAnalogTrack &T = A.Tracks[j];
-			T.KeyQuat.Empty(Src.NumRawFrames);
-			T.KeyQuat.Add  (Src.NumRawFrames);
-			T.KeyPos .Empty(Src.NumRawFrames);
-			T.KeyPos .Add  (Src.NumRawFrames);
-			T.KeyTime.Empty(Src.NumRawFrames);
-			T.KeyTime.Add  (Src.NumRawFrames);
-		}
-		// copy keys
-#if !FIXED_FRAME_TIME
-		float Time = 0;
-#endif
-		const VQuatAnimKey *SrcKey = &Keys[Src.FirstRawFrame * numBones];
-		for (j = 0; j < Src.NumRawFrames; j++)
-		{
-#if !FIXED_FRAME_TIME
-			float frameTime = SrcKey->Time;
-#endif
-			for (k = 0; k < numBones; k++, SrcKey++, KeyIndex++)
-			{
-				assert(KeyIndex < numKeys);
-				CAnalogTrack &T = A.Tracks[k];
-				T.KeyQuat[j] = SrcKey->Orientation;
-				T.KeyPos [j] = SrcKey->Position;
-#if !FIXED_FRAME_TIME
-				T.KeyTime[j] = Time;
-				// check: all bones in single key should have save time interval
-				if (frameTime != SrcKey->Time)
-					appNotify("Anim(%s): incorrect time for bone %s, key %d: %g != %g",
-						*A.Name, *Anim.TrackBoneName[k].Name, j, SrcKey->Time, frameTime);
-#else
-				T.KeyTime[j] = j;		// equals to frame number
-#endif
-			}
-#if !FIXED_FRAME_TIME
-			Time += frameTime;
-#endif
-		}
-		unguard;
+		if (Src.FirstRawFrame < 0 || Src.NumRawFrames < 0 ||
+			((qword)Src.FirstRawFrame + Src.NumRawFrames) * numBones > (qword)numKeys)
+			appError("Anim(%s): wrong key range", *A.Name);
+		KeyIndex += Src.NumRawFrames * numBones;
 	}
 	if (KeyIndex != numKeys)
-		appNotify("WARNING: Imported %d keys of %d", KeyIndex, numKeys);
+		Log->Add(IW_WrongKeyCount, "imported %d keys of %d", KeyIndex, numKeys);
+
+	// build and reduce sequences in parallel
+	CPsaImportContext Ctx;
+	Ctx.Anim     = &Anim;
+	Ctx.AnimInfo = numAnims ? &AnimInfo[0] : NULL;
+	Ctx.Keys     = KeyData;
+	Ctx.NumBones = numBones;
+	Ctx.Log      = Log;
+	Ctx.Stats.Empty(numAnims * 4);
+	Ctx.Stats.Add(numAnims * 4);
+	appParallelFor(numAnims, ImportPsaSequence, &Ctx, IMPORT_THREADS);
+
+	// print statistics in the same way as RemoveRedundantKeys() and CompressAnimation()
+	int Stats[4] = { 0, 0, 0, 0 };
+	for (i = 0; i < numAnims * 4; i++)
+		Stats[i & 3] += Ctx.Stats[i];
+	appPrintf("Removed %d of %d (%.0f%%) redundant keys\n", Stats[0], Stats[1],
+		Stats[1] ? Stats[0] * 100.0f / Stats[1] : 0.0f);
+	appPrintf("Compression: removed %d of %d (%.0f%%) keys\n", Stats[2], Stats[3],
+		Stats[3] ? Stats[2] * 100.0f / Stats[3] : 0.0f);
 	unguard;
 
-	RemoveRedundantKeys(Anim);
-	CompressAnimation(Anim);		//!! SHOULD BE CALLED FROM UI
+	Log->Report();
 
 	unguard;
 }
@@ -3,6 +3,7 @@
 -----------------------------------------------------------------------------*/
 
 #include <wx/wx.h>
+#include <wx/thread.h>
 #include "Core.h"
 
 #include "LogWindow.h"
@@ -30,6 +31,10 @@ void WLogWindow::OnFrameDelete(wxFrame *frame)
 	// unregister logger
 	wxLog::SetActiveTarget(NULL);
 	COutputDevice::Unregister();
+	// text, which was not displayed yet, has nowhere to go
+	PendingLock.Enter();
+	Pending.Empty();
+	PendingLock.Leave();
 	// save window position etc
 	CollectSettings();
 }
@@ -37,13 +42,38 @@ void WLogWindow::OnFrameDelete(wxFrame *frame)
 
 void WLogWindow::Write(const char *str)
 {
+	// called from Core logger thread (or from any thread, which drains log buffer),
+	// so wx controls should not be touched here: text is queued and displayed by
+	// FlushPending() in GUI thread
+	int len = strlen(str);
+	if (!len) return;
+	CCriticalSectionScope Lock(PendingLock);
+	int pos = Pending.AddNoInit(len);
+	memcpy(&Pending[pos], str, len);
+}
+
+
+void WLogWindow::Flush()
+{
+	FlushPending();
+}
+
+
+void WLogWindow::FlushPending()
+{
+	if (!Pending.Num() || !wxThread::IsMain()) return;
+	TArray<char> Text;
+	PendingLock.Enter();
+	Text = Pending;
+	Pending.Empty();
+	PendingLock.Leave();
+
 	// wxLog will automatically add "\n" in every call to wxLogMessage(),
 	// so we need to accumulate message to allow printing single line within
 	// a few appPrintf() calls
-	while (true)
+	for (int i = 0; i < Text.Num(); i++)
 	{
-		char c = *str++;
-		if (!c) break;
+		char c = Text[i];
 		if (c == '\n' || cursor >= MAX_LOG_LINE-1)
 		{
 			// wxLog will automatically append "\n", so skip it
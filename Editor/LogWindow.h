@@ -23,6 +23,8 @@ public:
 	wxFrame		*pParent;
 	char		buf[MAX_LOG_LINE];
 	int			cursor;
+	CCriticalSection PendingLock;
+	TArray<char> Pending;			// text, written by Write() and not displayed yet
 
 	WLogWindow(wxFrame *parent);
 
@@ -30,6 +32,13 @@ public:
 	 *	COutputDevice methods
 	 */
 	virtual void Write(const char *str);
+	virtual void Flush();
+
+	/**
+	 *	Display text, queued by Write(). Does nothing, when called not from GUI
+	 *	thread; should be called periodically (from idle handler).
+	 */
+	void FlushPending();
 
 	/**
 	 *	wxLogWindow methods
@@ -12,13 +12,16 @@
 // Core includes
 #include "GlViewport.h"
 #include "FileReaderStdio.h"
+#include "FileReaderMapped.h"
 
 // Skeletal mesh support
+#include "CoreClasses.h"
 #include "AnimClasses.h"
 #include "SkelMeshInstance.h"
 
 #include "EditorClasses.h"
 #include "Import.h"
+#include "AnimCompression.h"
 
 // Property editor
 #include "PropEdit.h"
@@ -47,6 +50,15 @@
 static CSkeletalMesh		*EditorMesh;
 static CAnimSet				*EditorAnim;
 static CSkelMeshInstance	*MeshInst;
+// content hashes of EditorMesh/EditorAnim, when they were loaded or saved; 0 = not saved
+static qword				EditorMeshHash;
+static qword				EditorAnimHash;
+
+// compression flags for saving resources
+static int GetSaveCompression()
+{
+	return GCfg.CompressFiles ? COMPRESS_LZ|COMPRESS_FILTER : COMPRESS_NONE;
+}
 
 static WLogWindow			*GLogWindow;
 
@@ -173,10 +185,16 @@ public:
 	{
 		guard(WCanvas::Render);
 
+		// release scratch memory, allocated while rendering this frame
+		CScratchScope Scratch;
+
 		unsigned currTime = GetMilliseconds();
 		float frameTime = (currTime - m_lastFrameTime) / 1000.0f;
 		m_lastFrameTime = currTime;
 		DrawTextRight("FPS: " S_GREEN "%5.1f", 1.0f / frameTime);
+#if MEM_STATS
+		DrawTextRight("Allocs: " S_GREEN "%d", appMemoryFrame());
+#endif
 
 		// prepare frame
 		RenderBackground();
@@ -423,6 +441,7 @@ public:
 	void ImportMesh(const char *Filename)
 	{
 		guard(WMainFrame::ImportMesh);
+		MEM_TAG(MEM_Mesh);
 
 		wxFileName fn(Filename);	// using wxFileName here for GetName() function
 		m_meshFilename = "Imported_" + fn.GetName() + "." MESH_EXTENSION;
@@ -430,7 +449,8 @@ public:
 
 		appSetNotifyHeader("Importing mesh from %s", Filename);
 		EditorMesh = new CSkeletalMesh;
-		CFile Ar(Filename);			// note: will throw appError when failed
+		EditorMeshHash = 0;
+		CMappedFile Ar(Filename);	// note: will throw appError when failed
 		ImportPsk(Ar, *EditorMesh);
 		EditorMesh->PostLoad();		// generate extra data
 
@@ -765,6 +785,13 @@ protected:
 		GetMenuBar()->FindItem(XRCID("ID_SHOWLOG"))->Check(false);
 	}
 
+	void OnDumpMemory(wxCommandEvent&)
+	{
+		GLogWindow->Show(true);
+		GetMenuBar()->FindItem(XRCID("ID_SHOWLOG"))->Check(true);
+		appDumpMemoryStats();
+	}
+
 	void OnSettings(wxCommandEvent&)
 	{
 		guard(WMainFrame::OnSettings);
@@ -809,7 +836,8 @@ protected:
 			const char *filename2 = filename.c_str();	// wxString.c_str() has known bugs with printf-like functions, so use intermediate variable
 			appSetNotifyHeader("Importing mesh from %s", filename2);
 			EditorMesh = new CSkeletalMesh;
-			CFile Ar(filename2);		// note: will throw appError when failed
+			EditorMeshHash = 0;
+			CMappedFile Ar(filename2);	// note: will throw appError when failed
 			ImportPsk(Ar, *EditorMesh);
 			EditorMesh->PostLoad();		// generate extra data
 
@@ -835,9 +863,11 @@ protected:
 			m_meshFilename = dlg.GetPath();
 			if (EditorMesh) delete EditorMesh;
 
+			MEM_TAG(MEM_Mesh);
 			EditorMesh = CSkeletalMesh::LoadObject(m_meshFilename.c_str());
 			if (EditorMesh)
 			{
+				EditorMeshHash = GetObjectHash(EditorMesh);
 				UseMesh(EditorMesh);
 			}
 			else
@@ -859,8 +889,8 @@ protected:
 		{
 			m_meshFilename = dlg.GetPath();
 			m_meshFilenameEdit->SetValue(m_meshFilename);
-			CFile Ar(m_meshFilename.c_str(), false);		// note: will throw appError when failed
-			SerializeObject(EditorMesh, Ar);
+			// note: will throw appError when failed; file is not rewritten, when not changed
+			SaveObjectFile(EditorMesh, m_meshFilename.c_str(), &EditorMeshHash, GetSaveCompression());
 		}
 		unguard;
 	}
@@ -881,13 +911,16 @@ protected:
 		{
 			wxFileName fn = dlg.GetFilename();
 			m_animFilename = "Imported_" + fn.GetName() + "." ANIM_EXTENSION;
+			if (MeshInst) MeshInst->SetAnim(NULL);
 			if (EditorAnim) delete EditorAnim;
 
 			wxString filename = dlg.GetPath();
 			const char *filename2 = filename.c_str();
 			appSetNotifyHeader("Importing animations from %s", filename2);
+			MEM_TAG(MEM_Anim);
 			EditorAnim = new CAnimSet;
-			CFile Ar(filename.c_str());	// note: will throw appError when failed
+			EditorAnimHash = 0;
+			CMappedFile Ar(filename2);	// note: will throw appError when failed
 			ImportPsa(Ar, *EditorAnim);
 
 			appSetNotifyHeader("");
@@ -908,14 +941,17 @@ protected:
 		if (dlg.ShowModal() == wxID_OK)
 		{
 			m_animFilename = dlg.GetPath();
+			if (MeshInst) MeshInst->SetAnim(NULL);
 			if (EditorAnim) delete EditorAnim;
 
+			MEM_TAG(MEM_Anim);
 			EditorAnim = CAnimSet::LoadObject(m_animFilename.c_str());
 			if (!EditorAnim)
 			{
 				wxMessageBox(m_animFilename, "Unable to load AnimSet", wxOK | wxICON_ERROR);
 				return;
 			}
+			EditorAnimHash = GetObjectHash(EditorAnim);
 			UseAnimSet(EditorAnim);
 		}
 
@@ -932,12 +968,58 @@ protected:
 		{
 			m_animFilename = dlg.GetPath();
 			m_animFilenameEdit->SetValue(m_animFilename);
-			CFile Ar(m_animFilename.c_str(), false);		// note: will throw appError when failed
-			SerializeObject(EditorAnim, Ar);
+			SaveObjectFile(EditorAnim, m_animFilename.c_str(), &EditorAnimHash, GetSaveCompression());
 		}
 		unguard;
 	}
 
+	/**
+	 *	AnimSet tracks operations
+	 */
+	void OnStripPositions(wxCommandEvent&)
+	{
+		guard(WMainFrame::OnStripPositions);
+		if (!EditorAnim) return;
+		if (wxMessageBox("Position keys will be removed from all non-root bone tracks,\n"
+			"mesh reference pose will be used instead. Continue ?", "Warning",
+			wxICON_QUESTION | wxYES_NO) == wxNO)
+			return;
+
+		StopAnimation();
+		StripPositionTracks(*EditorAnim, EditorMesh);
+		UseAnimSet(EditorAnim);
+
+		unguard;
+	}
+
+	void OnRemoveUnusedTracks(wxCommandEvent&)
+	{
+		guard(WMainFrame::OnRemoveUnusedTracks);
+		if (!EditorAnim || !EditorMesh) return;
+		if (wxMessageBox("Tracks of bones, which are not present in current mesh, will be removed. Continue ?",
+			"Warning", wxICON_QUESTION | wxYES_NO) == wxNO)
+			return;
+
+		StopAnimation();
+		const CSkeletalMesh *Meshes[1] = { EditorMesh };
+		RemoveUnusedTracks(*EditorAnim, ARRAY_ARG(Meshes));
+		UseAnimSet(EditorAnim);		// will remap mesh bones to new tracks
+
+		unguard;
+	}
+
+	void OnPoolTracks(wxCommandEvent&)
+	{
+		guard(WMainFrame::OnPoolTracks);
+		if (!EditorAnim) return;
+
+		StopAnimation();
+		PoolTracks(*EditorAnim, 0.001f);
+		UseAnimSet(EditorAnim);
+
+		unguard;
+	}
+
 	/**
      *	Mesh bounding boxes support
      */
@@ -1062,6 +1144,9 @@ protected:
 	{
 		guard(WMainFrame::OnIdle);
 
+		// display text, logged by other threads
+		if (GLogWindow) GLogWindow->FlushPending();
+
 		// update local animation state
 		unsigned currTime = GetMilliseconds();
 		float frameTime = (currTime - m_lastFrameTime) / 1000.0f;
@@ -1130,6 +1215,7 @@ BEGIN_EVENT_TABLE(WMainFrame, wxFrame)
 	EVT_MENU(XRCID("ID_HIDETOPPANE"),    WMainFrame::OnHideTop   )
 	EVT_MENU(XRCID("ID_HIDEBOTTOMPANE"), WMainFrame::OnHideBottom)
 	EVT_MENU(XRCID("ID_SHOWLOG"),        WMainFrame::OnShowLog   )
+	EVT_MENU(XRCID("ID_DUMPMEMORY"),     WMainFrame::OnDumpMemory)
 	EVT_MENU(XRCID("ID_SETTINGS"),       WMainFrame::OnSettings  )
 	EVT_MENU(XRCID("ID_MENUTEST"),       WMainFrame::OnMenuTest  )	//???
 	EVT_MENU(XRCID("ID_MESHOPEN"),       WMainFrame::OnLoadMesh  )
@@ -1145,6 +1231,9 @@ BEGIN_EVENT_TABLE(WMainFrame, wxFrame)
 	EVT_MENU(XRCID("ID_RECREATEHITBOXES"), WMainFrame::OnRecreateHitboxes)
 	EVT_MENU(XRCID("ID_NEWSOCKET"),      WMainFrame::OnNewSocket )
 	EVT_MENU(XRCID("ID_DUMPBONES"),      WMainFrame::OnDumpBones )
+	EVT_MENU(XRCID("ID_STRIPPOSITIONS"), WMainFrame::OnStripPositions)
+	EVT_MENU(XRCID("ID_REMOVEUNUSEDTRACKS"), WMainFrame::OnRemoveUnusedTracks)
+	EVT_MENU(XRCID("ID_POOLTRACKS"), WMainFrame::OnPoolTracks)
 	HOOK_TOGGLE(AXIS       )
 	HOOK_TOGGLE(TEXTURING  )
 	HOOK_TOGGLE(WIREFRAME  )
@@ -1197,6 +1286,7 @@ public:
 			appNotify("ERROR: %s\n", GErrorHistory);
 		else
 			appNotify("Unknown error\n");
+		appFlushLog();
 		wxMessageBox(GErrorHistory, "Fatal error", wxOK | wxICON_ERROR);
 	}
 
@@ -1213,6 +1303,7 @@ public:
 		try
 		{
 			guard(WApp::OnInit);
+			MEM_TAG(MEM_Editor);
 
 #ifdef ZIP_RESOURCES
 			wxFileSystem::AddHandler(new wxZipFSHandler);
@@ -1228,10 +1319,24 @@ public:
 
 			GLogWindow = new WLogWindow(frame);
 
-			// init typeinfo
-			CFile Ar(TYPEINFO_FILE);		//?? move to appInit()
-			InitTypeinfo(Ar);
-			Ar.Close();
+			// init typeinfo; use static tables, when they were generated by script compiler
+			static const CTypeinfoDecl *const TypeTables[] =
+			{
+				CORE_TYPEINFO_TABLE
+				ANIM_TYPEINFO_TABLE
+				EDITOR_TYPEINFO_TABLE
+				NULL
+			};
+			if (TypeTables[0])
+			{
+				InitTypeinfo(TypeTables);
+			}
+			else
+			{
+				CFile Ar(TYPEINFO_FILE);	//?? move to appInit()
+				InitTypeinfo(Ar);
+				Ar.Close();
+			}
 			BEGIN_CLASS_TABLE
 				REGISTER_ANIM_CLASSES
 			END_CLASS_TABLE
@@ -1308,10 +1413,10 @@ public:
 				SaveSettings();
 				unguard;
 			}
-			// free allocated animation resources
+			// free allocated animation resources; instance is using mesh and AnimSet
+			if (MeshInst)   delete MeshInst;
 			if (EditorMesh) delete EditorMesh;
 			if (EditorAnim) delete EditorAnim;
-			if (MeshInst)   delete MeshInst;
 			return result;
 			unguard;
 		}
@@ -1322,25 +1427,27 @@ public:
 			DisplayError();
 			// emergency save edited data
 			bool savedMesh = false, savedAnim = false;
-			if (EditorMesh)
+			if (EditorMesh && !IsSaved(EditorMesh, EditorMeshHash))
 			{
 				try
 				{
 					appNotify("Saving mesh to autosave");
 					CFile Ar("autosave." MESH_EXTENSION, false);
 					SerializeObject(EditorMesh, Ar);
+					Ar.Close();
 					savedMesh = true;
 				}
 				catch (...)
 				{}
 			}
-			if (EditorAnim)
+			if (EditorAnim && !IsSaved(EditorAnim, EditorAnimHash))
 			{
 				try
 				{
 					appNotify("Saving animations to autosave");
 					CFile Ar("autosave." ANIM_EXTENSION, false);
 					SerializeObject(EditorAnim, Ar);
+					Ar.Close();
 					savedAnim = true;
 				}
 				catch (...)
@@ -1361,6 +1468,21 @@ public:
 	{
 		throw;
 	}
+
+protected:
+	// check whether object has the same content, as when it was loaded or saved
+	static bool IsSaved(CObject *Obj, qword SavedHash)
+	{
+		if (!SavedHash) return false;
+		try
+		{
+			return GetObjectHash(Obj) == SavedHash;
+		}
+		catch (...)
+		{
+			return false;				// object is damaged, try to save it anyway
+		}
+	}
 };
 
 wxIMPLEMENT_APP(WApp);
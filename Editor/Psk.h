@@ -48,6 +48,8 @@ struct VVertex
 	}
 };
 
+RAW_TYPE(VVertex)
+
 
 struct VTriangle16
 {
@@ -64,6 +66,8 @@ struct VTriangle16
 	}
 };
 
+RAW_TYPE(VTriangle16)
+
 
 // the same as VTriangle16 but with 32-bit vertex indices
 //!! note: this structure has different on-disk and in-memory layout and size (due to alignment)
@@ -113,6 +117,8 @@ struct VMaterial
 	}
 };
 
+RAW_TYPE(VMaterial)
+
 
 // A bone: an orientation, and a position, all relative to their parent.
 struct VJointPos
@@ -128,6 +134,8 @@ struct VJointPos
 	}
 };
 
+RAW_TYPE(VJointPos)
+
 
 struct VBone
 {
@@ -144,6 +152,8 @@ struct VBone
 	}
 };
 
+RAW_TYPE(VBone)
+
 
 struct VRawBoneInfluence
 {
@@ -157,6 +167,8 @@ struct VRawBoneInfluence
 	}
 };
 
+RAW_TYPE(VRawBoneInfluence)
+
 
 /******************************************************************************
  *	PSA file format structures
@@ -178,6 +190,8 @@ struct FNamedBoneBinary
 	}
 };
 
+RAW_TYPE(FNamedBoneBinary)
+
 
 // Binary animation info format - used to organize raw animation keys into FAnimSeqs on rebuild
 // Similar to MotionChunkDigestInfo.
@@ -208,6 +222,8 @@ struct AnimInfoBinary
 	}
 };
 
+RAW_TYPE(AnimInfoBinary)
+
 
 struct VQuatAnimKey
 {
@@ -222,5 +238,7 @@ struct VQuatAnimKey
 	}
 };
 
+RAW_TYPE(VQuatAnimKey)
+
 
 #endif // __PSK_H__
@@ -0,0 +1,245 @@
+#include "Core.h"
+#include "FileReaderStdio.h"
+#include "FileReaderMapped.h"
+
+#include "CoreClasses.h"
+#include "AnimClasses.h"
+#include "SkelMeshInstance.h"
+
+#include "SkelRuntime.h"
+
+
+/*-----------------------------------------------------------------------------
+	Error handling
+-----------------------------------------------------------------------------*/
+
+// Library is built with RETAIL, so asserts are compiled out; functions below are
+// validating their arguments with appError() instead.
+
+// Exceptions should not leave the library: game code may be compiled without
+// them, or use its own. Each API function is wrapped with these macros, error
+// history remains in GErrorHistory and is returned by SkelGetError().
+#define API_BEGIN(func)		\
+	appResetError();		\
+	try						\
+	{						\
+		guard(func);
+
+#define API_END(failValue)	\
+		unguard;			\
+	}						\
+	catch (...)				\
+	{						\
+		return failValue;	\
+	}
+
+
+const char *SkelGetError()
+{
+	return GErrorHistory;
+}
+
+
+/*-----------------------------------------------------------------------------
+	Initialization
+-----------------------------------------------------------------------------*/
+
+bool SkelInit(const char *TypeinfoFile)
+{
+	API_BEGIN(SkelInit);
+
+	appInit();
+	// init typeinfo; use static tables, when they were generated by script compiler
+	static const CTypeinfoDecl *const TypeTables[] =
+	{
+		CORE_TYPEINFO_TABLE
+		ANIM_TYPEINFO_TABLE
+		NULL
+	};
+	if (TypeTables[0])
+	{
+		InitTypeinfo(TypeTables);
+	}
+	else
+	{
+		CFile Ar(TypeinfoFile);
+		InitTypeinfo(Ar);
+		Ar.Close();
+	}
+	BEGIN_CLASS_TABLE
+		REGISTER_ANIM_CLASSES
+	END_CLASS_TABLE
+	return true;
+
+	API_END(false);
+}
+
+
+/*-----------------------------------------------------------------------------
+	Resources
+-----------------------------------------------------------------------------*/
+
+CSkeletalMesh *SkelLoadMesh(const char *Filename)
+{
+	API_BEGIN(SkelLoadMesh);
+
+	CMappedFile Ar;
+	if (!Ar.Open(Filename)) appError("Unable to open file %s", Filename);
+	CSkeletalMesh *Mesh = new CSkeletalMesh;
+	try
+	{
+		SerializeObject(Mesh, Ar);
+	}
+	catch (...)
+	{
+		delete Mesh;
+		throw;
+	}
+	return Mesh;
+
+	API_END(NULL);
+}
+
+
+void SkelFreeMesh(CSkeletalMesh *Mesh)
+{
+	delete Mesh;
+}
+
+
+CAnimSet *SkelLoadAnim(const char *Filename, bool LazyLoad, int MemoryBudget)
+{
+	API_BEGIN(SkelLoadAnim);
+
+	if (LazyLoad)
+	{
+		CAnimSet *Anim = CAnimSet::LoadObjectLazy(Filename, MemoryBudget);
+		if (!Anim) appError("Unable to open file %s", Filename);
+		return Anim;
+	}
+	CMappedFile Ar;
+	if (!Ar.Open(Filename)) appError("Unable to open file %s", Filename);
+	CAnimSet *Anim = new CAnimSet;
+	try
+	{
+		SerializeObject(Anim, Ar);
+	}
+	catch (...)
+	{
+		delete Anim;
+		throw;
+	}
+	return Anim;
+
+	API_END(NULL);
+}
+
+
+void SkelFreeAnim(CAnimSet *Anim)
+{
+	delete Anim;
+}
+
+
+int SkelGetNumAnims(const CAnimSet *Anim)
+{
+	return Anim->Sequences.Num();
+}
+
+
+const char *SkelGetAnimName(const CAnimSet *Anim, int AnimIndex)
+{
+	if (AnimIndex < 0 || AnimIndex >= Anim->Sequences.Num()) return NULL;
+	return Anim->Sequences[AnimIndex].Name;
+}
+
+
+/*-----------------------------------------------------------------------------
+	Mesh instances
+-----------------------------------------------------------------------------*/
+
+CSkelMeshInstance *SkelCreateInstance(const CSkeletalMesh *Mesh, CAnimSet *Anim)
+{
+	API_BEGIN(SkelCreateInstance);
+
+	if (!Mesh) appError("NULL mesh");
+	CSkelMeshInstance *Inst = new CSkelMeshInstance;
+	Inst->SetMesh(Mesh);
+	if (Anim) Inst->SetAnim(Anim);
+	return Inst;
+
+	API_END(NULL);
+}
+
+
+void SkelDestroyInstance(CSkelMeshInstance *Inst)
+{
+	delete Inst;
+}
+
+
+bool SkelPlayAnim(CSkelMeshInstance *Inst, const char *AnimName, float Rate, float TweenTime,
+	int Channel, bool Looped)
+{
+	API_BEGIN(SkelPlayAnim);
+
+	if (Channel < 0 || Channel >= MAX_SKELANIMCHANNELS) appError("wrong channel %d", Channel);
+	if (AnimName && !Inst->HasAnim(AnimName)) appError("unknown animation %s", AnimName);
+	if (Looped)
+		Inst->LoopAnim(AnimName, Rate, TweenTime, Channel);
+	else
+		Inst->PlayAnim(AnimName, Rate, TweenTime, Channel);
+	return true;
+
+	API_END(false);
+}
+
+
+bool SkelUpdate(CSkelMeshInstance *Inst, float TimeDelta)
+{
+	API_BEGIN(SkelUpdate);
+	Inst->UpdateAnimation(TimeDelta);
+	return true;
+	API_END(false);
+}
+
+
+/*-----------------------------------------------------------------------------
+	Skeleton
+-----------------------------------------------------------------------------*/
+
+int SkelGetNumBones(const CSkeletalMesh *Mesh)
+{
+	return Mesh->Skeleton.Num();
+}
+
+
+const char *SkelGetBoneName(const CSkeletalMesh *Mesh, int BoneIndex)
+{
+	if (BoneIndex < 0 || BoneIndex >= Mesh->Skeleton.Num()) return NULL;
+	return Mesh->Skeleton[BoneIndex].Name;
+}
+
+
+// CCoords is 4 CVec3 values, i.e. SKEL_COORDS_FLOATS floats, so it is copied as is
+
+bool SkelGetBoneCoords(const CSkelMeshInstance *Inst, float *Coords)
+{
+	API_BEGIN(SkelGetBoneCoords);
+	int NumBones = Inst->pMesh->Skeleton.Num();
+	for (int i = 0; i < NumBones; i++, Coords += SKEL_COORDS_FLOATS)
+		memcpy(Coords, &Inst->GetBoneCoords(i), sizeof(CCoords));
+	return true;
+	API_END(false);
+}
+
+
+bool SkelGetSkinningTransforms(const CSkelMeshInstance *Inst, float *Coords)
+{
+	API_BEGIN(SkelGetSkinningTransforms);
+	int NumBones = Inst->pMesh->Skeleton.Num();
+	for (int i = 0; i < NumBones; i++, Coords += SKEL_COORDS_FLOATS)
+		memcpy(Coords, &Inst->GetBoneTransform(i), sizeof(CCoords));
+	return true;
+	API_END(false);
+}
@@ -0,0 +1,79 @@
+#ifndef __SKELRUNTIME_H__
+#define __SKELRUNTIME_H__
+
+
+/*-----------------------------------------------------------------------------
+	SkelRuntime: minimal API for linking Core and Anim code into the game
+
+	This header is self-contained: it does not include Core.h, so it will not
+	bring Core macros into the game code. The library does not replace global
+	operator new/delete, so the game may use its own allocator; library objects
+	are allocated and released by the library's own heap, so use SkelFree*() and
+	SkelDestroyInstance() instead of 'delete'.
+
+	Functions are not throwing: on failure they return NULL/false, and the error
+	message with call history may be retrieved with SkelGetError(). Error state
+	is kept per thread.
+-----------------------------------------------------------------------------*/
+
+#include <stddef.h>						// NULL
+
+class CSkeletalMesh;
+class CAnimSet;
+class CSkelMeshInstance;
+
+
+// number of floats per bone in SkelGetBoneCoords() and SkelGetSkinningTransforms():
+// origin, followed by 3 axis vectors
+#define SKEL_COORDS_FLOATS		12
+
+
+/**
+ * Initialize typeinfo and class registry. Uses static typeinfo tables, when they
+ * were compiled into the library, otherwise loads TypeinfoFile.
+ */
+bool SkelInit(const char *TypeinfoFile = "typeinfo.bin");
+
+/**
+ * Error message with call history for the last failed function called in the
+ * current thread. Returns empty string when the last call succeeded.
+ */
+const char *SkelGetError();
+
+// resources
+CSkeletalMesh *SkelLoadMesh(const char *Filename);
+void SkelFreeMesh(CSkeletalMesh *Mesh);
+/**
+ * Load an AnimSet. When LazyLoad is true, animation tracks are loaded on first use;
+ * non-zero MemoryBudget limits amount of memory used by loaded tracks.
+ */
+CAnimSet *SkelLoadAnim(const char *Filename, bool LazyLoad = false, int MemoryBudget = 0);
+void SkelFreeAnim(CAnimSet *Anim);
+int SkelGetNumAnims(const CAnimSet *Anim);
+const char *SkelGetAnimName(const CAnimSet *Anim, int AnimIndex);
+
+// mesh instances
+/**
+ * Create instance of mesh. Sequences, played by instance, are kept loaded in lazily
+ * loaded AnimSet, so instances should be destroyed before their AnimSet is freed.
+ */
+CSkelMeshInstance *SkelCreateInstance(const CSkeletalMesh *Mesh, CAnimSet *Anim = NULL);
+void SkelDestroyInstance(CSkelMeshInstance *Inst);
+
+bool SkelPlayAnim(CSkelMeshInstance *Inst, const char *AnimName, float Rate = 1, float TweenTime = 0,
+	int Channel = 0, bool Looped = false);
+bool SkelUpdate(CSkelMeshInstance *Inst, float TimeDelta);
+
+// skeleton
+int SkelGetNumBones(const CSkeletalMesh *Mesh);
+const char *SkelGetBoneName(const CSkeletalMesh *Mesh, int BoneIndex);
+/**
+ * Copy current bone poses of instance to Coords array of SKEL_COORDS_FLOATS * NumBones
+ * floats. SkelGetBoneCoords() returns bone positions in model space, SkelGetSkinningTransforms()
+ * returns transforms from reference pose, suitable for vertex skinning.
+ */
+bool SkelGetBoneCoords(const CSkelMeshInstance *Inst, float *Coords);
+bool SkelGetSkinningTransforms(const CSkelMeshInstance *Inst, float *Coords);
+
+
+#endif // __SKELRUNTIME_H__
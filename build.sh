@@ -4,7 +4,9 @@ project="skeledit.project"
 resfile="resource.bin"
 
 # compile scripts
-Tools/ucc --type=typeinfo.bin Core Anim Editor || exit
+# STATIC_TYPEINFO=1 will compile typeinfo into executable, so typeinfo.bin will not be used
+[ "$STATIC_TYPEINFO" ] && UCC_OPTIONS="--cpp"
+Tools/ucc --type=typeinfo.bin $UCC_OPTIONS Core Anim Editor || exit
 
 [ "$PLATFORM" ] || PLATFORM="vc-win32"
 